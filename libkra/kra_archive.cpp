@@ -0,0 +1,364 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_archive.h"
+
+#include <chrono>
+#include <filesystem>
+#include <new>
+
+namespace kra
+{
+    bool EntryData::is_view() const
+    {
+        return source != nullptr;
+    }
+
+    Archive::~Archive()
+    {
+        close();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Open the KRA/KRZ-archive at the given path and index all of its entries
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::open(const std::string &p_path)
+    {
+        close();
+
+        /* When possible the archive is memory-mapped so that minizip doesn't have to go through stdio for every read */
+        if (archive_backend == MMAP_BACKEND)
+        {
+            std::shared_ptr<MappedFile> mapped_file = std::make_shared<MappedFile>();
+            if (mapped_file->open(p_path) == 0)
+            {
+                return open(mapped_file);
+            }
+
+            if (verbosity_level >= VERBOSE)
+            {
+                fprintf(stdout, "Failed to memory-map archive at path '%s', falling back to stdio\n", p_path.c_str());
+            }
+        }
+
+        _file = unzOpen(p_path.c_str());
+        if (_file == NULL)
+        {
+            return 1;
+        }
+        _path = p_path;
+
+        /* When the size can't be determined it stays zero, in which case only the ratio of the entry sizes is checked */
+        std::error_code error;
+        const std::uintmax_t archive_size = std::filesystem::file_size(p_path, error);
+        _archive_size = error ? 0 : (uint64_t)archive_size;
+
+        return _build_entry_index();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Open a KRA/KRZ-archive whose raw bytes are served by the given reader and index all of its entries
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::open(std::shared_ptr<ArchiveReader> p_reader)
+    {
+        close();
+
+        _reader = p_reader;
+
+        zlib_filefunc64_def filefunc;
+        fill_archive_reader_filefunc(&filefunc, _reader.get());
+        /* The path is never used by the reader's callbacks */
+        _file = unzOpen2_64(NULL, &filefunc);
+        if (_file == NULL)
+        {
+            _reader.reset();
+            return 1;
+        }
+        _archive_size = _reader->get_size();
+
+        return _build_entry_index();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Open an independent handle to the same archive as the given one, which allows both to be read concurrently
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::open(const Archive &p_archive)
+    {
+        close();
+
+        if (p_archive._reader != nullptr)
+        {
+            /* Both handles share the same reader, each minizip stream having its own read position */
+            _reader = p_archive._reader;
+
+            zlib_filefunc64_def filefunc;
+            fill_archive_reader_filefunc(&filefunc, _reader.get());
+            _file = unzOpen2_64(NULL, &filefunc);
+        }
+        else if (!p_archive._path.empty())
+        {
+            _path = p_archive._path;
+            _file = unzOpen(_path.c_str());
+        }
+
+        if (_file == NULL)
+        {
+            _reader.reset();
+            _path.clear();
+            return 1;
+        }
+
+        /* The positions in the central directory are identical, so the index is shared instead of built (or copied) again */
+        _entry_index = p_archive._entry_index;
+        _archive_size = p_archive._archive_size;
+        return 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Close the archive (if opened) and release the reader
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Archive::close()
+    {
+        if (_file != NULL)
+        {
+            unzClose(_file);
+            _file = NULL;
+        }
+        _reader.reset();
+        _path.clear();
+        _archive_size = 0;
+        _entry_index.reset();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get what the central directory tells us about the entry with the given name, without touching the entry itself
+    // ---------------------------------------------------------------------------------------------------------------------
+    const ArchiveEntry *Archive::find_entry(const std::string &p_entry_name) const
+    {
+        if (_entry_index == nullptr)
+        {
+            return nullptr;
+        }
+
+        auto it = _entry_index->find(p_entry_name);
+        if (it == _entry_index->end())
+        {
+            return nullptr;
+        }
+
+        return &it->second;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Make the entry with the given name the current file of the archive
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::locate_entry(const std::string &p_entry_name)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_entry_index == nullptr)
+        {
+            return UNZ_END_OF_LIST_OF_FILE;
+        }
+
+        auto it = _entry_index->find(p_entry_name);
+        if (it == _entry_index->end())
+        {
+            return UNZ_END_OF_LIST_OF_FILE;
+        }
+
+        return unzGoToFilePos64(_file, &it->second.position);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find the entry with the given name and either view or extract its content
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::extract_entry(const std::string &p_entry_name, EntryData &p_result)
+    {
+        p_result = EntryData();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_entry_index == nullptr)
+        {
+            return UNZ_END_OF_LIST_OF_FILE;
+        }
+
+        auto it = _entry_index->find(p_entry_name);
+        if (it == _entry_index->end())
+        {
+            return UNZ_END_OF_LIST_OF_FILE;
+        }
+
+        /* Every buffer is allocated based on the sizes in the central directory, so those have to be checked first */
+        const ArchiveEntry &entry = it->second;
+        if (!is_plausible_entry_size(entry.compression_method, entry.compressed_size, entry.uncompressed_size, _archive_size))
+        {
+            fprintf(stderr, "ERROR: Archive entry '%s' has an invalid size of %llu bytes (%llu bytes compressed)\n", p_entry_name.c_str(),
+                    (unsigned long long)entry.uncompressed_size, (unsigned long long)entry.compressed_size);
+            return UNZ_BADZIPFILE;
+        }
+
+        int error_code = unzGoToFilePos64(_file, &entry.position);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
+
+        /* STORED entries are already present as-is in the archive, so there's no need to copy them when it is in memory */
+        if (_view_current_entry(entry, p_result) == UNZ_OK)
+        {
+            return UNZ_OK;
+        }
+
+        /* DEFLATED entries of archives in memory are inflated in one go, straight from the archive's bytes */
+        error_code = _inflate_current_entry(entry, p_result);
+        if (error_code != UNZ_PARAMERROR)
+        {
+            return error_code;
+        }
+
+        error_code = extract_current_file_to_buffer(_file, p_result.buffer, p_result.size);
+        p_result.data = p_result.buffer.get();
+        return error_code;
+    }
+
+    size_t Archive::get_entry_count() const
+    {
+        return (_entry_index != nullptr) ? _entry_index->size() : 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Walk the central directory exactly once and remember the position of every entry by its name
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::_build_entry_index()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<char> filename_inzip(256);
+        unz_file_info64 file_info;
+        std::shared_ptr<std::unordered_map<std::string, ArchiveEntry>> entry_index = std::make_shared<std::unordered_map<std::string, ArchiveEntry>>();
+
+        int error_code = unzGoToFirstFile(_file);
+        while (error_code == UNZ_OK)
+        {
+            error_code = unzGetCurrentFileInfo64(_file, &file_info, filename_inzip.data(), (uLong)filename_inzip.size(), NULL, 0, NULL, 0);
+            /* Entry names that don't fit in the buffer have to be fetched again */
+            if (error_code == UNZ_OK && file_info.size_filename >= filename_inzip.size())
+            {
+                filename_inzip.resize(file_info.size_filename + 1);
+                error_code = unzGetCurrentFileInfo64(_file, &file_info, filename_inzip.data(), (uLong)filename_inzip.size(), NULL, 0, NULL, 0);
+            }
+            if (error_code != UNZ_OK)
+            {
+                break;
+            }
+
+            ArchiveEntry entry;
+            unzGetFilePos64(_file, &entry.position);
+            entry.compression_method = file_info.compression_method;
+            entry.flag = file_info.flag;
+            entry.crc = file_info.crc;
+            entry.compressed_size = file_info.compressed_size;
+            entry.uncompressed_size = file_info.uncompressed_size;
+            /* Only the first entry with a given name is kept, which is identical to what unzLocateFile() would find */
+            entry_index->emplace(std::string(filename_inzip.data(), file_info.size_filename), entry);
+
+            error_code = unzGoToNextFile(_file);
+        }
+
+        _entry_index = entry_index;
+
+        if (verbosity_level >= VERBOSE)
+        {
+            const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            fprintf(stdout, "Indexed %zu archive entries in %.3f ms\n", _entry_index->size(), elapsed);
+        }
+
+        /* Reaching the end of the central directory is the expected outcome */
+        return (error_code == UNZ_END_OF_LIST_OF_FILE) ? UNZ_OK : error_code;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find out where the (compressed) data of the current entry starts in the archive
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::_get_current_entry_offset(const ArchiveEntry &p_entry, uint64_t &p_offset)
+    {
+        /* Opening the entry in raw mode makes minizip parse the local header, which tells us where the data actually starts */
+        int error_code = unzOpenCurrentFile2(_file, NULL, NULL, 1);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
+        p_offset = unzGetCurrentFileZStreamPos64(_file);
+        unzCloseCurrentFile(_file);
+
+        if (p_offset == 0 || p_offset + p_entry.compressed_size > _reader->get_size())
+        {
+            return UNZ_BADZIPFILE;
+        }
+
+        return UNZ_OK;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Point the result straight at the bytes of the current entry, only possible for unencrypted STORED entries in memory
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::_view_current_entry(const ArchiveEntry &p_entry, EntryData &p_result)
+    {
+        const bool is_stored = (p_entry.compression_method == 0);
+        const bool is_encrypted = (p_entry.flag & 1) != 0;
+        if (!is_stored || is_encrypted || _reader == nullptr || _reader->get_data() == nullptr)
+        {
+            return UNZ_PARAMERROR;
+        }
+
+        uint64_t offset;
+        int error_code = _get_current_entry_offset(p_entry, offset);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
+
+        p_result.source = _reader;
+        p_result.data = _reader->get_data() + offset;
+        p_result.size = (size_t)p_entry.compressed_size;
+        return UNZ_OK;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Inflate the current entry in one go without copying its compressed bytes, only possible for DEFLATED entries in memory
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Archive::_inflate_current_entry(const ArchiveEntry &p_entry, EntryData &p_result)
+    {
+        const bool is_deflated = (p_entry.compression_method == Z_DEFLATED);
+        const bool is_encrypted = (p_entry.flag & 1) != 0;
+        const bool has_data_descriptor = (p_entry.flag & 8) != 0;
+        if (!is_deflated || is_encrypted || has_data_descriptor || _reader == nullptr || _reader->get_data() == nullptr)
+        {
+            return UNZ_PARAMERROR;
+        }
+
+        uint64_t offset;
+        int error_code = _get_current_entry_offset(p_entry, offset);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
+
+        /* The buffer is left uninitialized, as every single byte of it gets overwritten anyway */
+        p_result.buffer.reset(new (std::nothrow) unsigned char[(size_t)p_entry.uncompressed_size]);
+        if (p_result.buffer == nullptr)
+        {
+            fprintf(stderr, "ERROR: Failed to allocate %zu bytes for an archive entry\n", (size_t)p_entry.uncompressed_size);
+            return UNZ_INTERNALERROR;
+        }
+        p_result.data = p_result.buffer.get();
+        p_result.size = (size_t)p_entry.uncompressed_size;
+
+        return inflate_entry_data(_reader->get_data() + offset, p_entry.compressed_size, p_result.buffer.get(), p_entry.uncompressed_size, p_entry.crc);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_ARCHIVE_H
+#define KRA_ARCHIVE_H
+
+#include "kra_utility.h"
+
+#include "kra_archive_reader.h"
+
+#include "../zlib/contrib/minizip/unzip.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace kra
+{
+    /* This struct stores what the central directory tells us about a single entry of the archive */
+    struct ArchiveEntry
+    {
+        unz64_file_pos position;
+
+        unsigned long compression_method;
+        unsigned long flag;
+        unsigned long crc;
+
+        uint64_t compressed_size;
+        uint64_t uncompressed_size;
+    };
+
+    /* This class holds the content of a single archive entry */
+    /* STORED entries of archives that are available in memory are never copied, in which case 'data' points straight into the archive */
+    class EntryData
+    {
+    public:
+        /* Only used when the entry had to be extracted */
+        std::unique_ptr<unsigned char[]> buffer;
+        /* Keeps the archive's memory alive for as long as 'data' might be pointing into it */
+        std::shared_ptr<ArchiveReader> source;
+
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+
+        bool is_view() const;
+    };
+
+    /* This class wraps an opened KRA/KRZ-archive together with an index of all the entries in its central directory */
+    /* The index is built once when opening the archive, so finding an entry doesn't require a linear scan anymore */
+    /* Locating and extracting entries is thread-safe, but every call is serialized on the same minizip handle */
+    class Archive
+    {
+    private:
+        /* NOTE: The reader has to outlive the unzFile, so it is declared first! */
+        /* This reader is empty when the archive is read through minizip's own stdio callbacks */
+        std::shared_ptr<ArchiveReader> _reader;
+        unzFile _file = NULL;
+
+        /* Only known when the archive was opened from a path, needed to open additional stdio handles */
+        std::string _path;
+        /* Size of the complete archive in bytes, no entry can ever be larger than this */
+        uint64_t _archive_size = 0;
+
+        /* The index never changes after it has been built, so additional handles to the same archive simply share it */
+        std::shared_ptr<const std::unordered_map<std::string, ArchiveEntry>> _entry_index;
+
+        /* Lazily loaded layers might extract their entries from multiple threads at once */
+        std::mutex _mutex;
+
+        int _build_entry_index();
+        int _get_current_entry_offset(const ArchiveEntry &p_entry, uint64_t &p_offset);
+        int _view_current_entry(const ArchiveEntry &p_entry, EntryData &p_result);
+        int _inflate_current_entry(const ArchiveEntry &p_entry, EntryData &p_result);
+
+    public:
+        ~Archive();
+
+        int open(const std::string &p_path);
+        int open(std::shared_ptr<ArchiveReader> p_reader);
+        int open(const Archive &p_archive);
+        void close();
+
+        const ArchiveEntry *find_entry(const std::string &p_entry_name) const;
+
+        int locate_entry(const std::string &p_entry_name);
+        int extract_entry(const std::string &p_entry_name, EntryData &p_result);
+
+        size_t get_entry_count() const;
+    };
+};
+
+#endif // KRA_ARCHIVE_H
\ No newline at end of file
@@ -0,0 +1,235 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_archive_reader.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kra
+{
+    /* Every call to zopen64_file gets its own read cursor, all of them sharing the same reader */
+    struct ArchiveReaderStream
+    {
+        ArchiveReader *reader;
+        uint64_t position;
+    };
+
+    const uint8_t *ArchiveReader::get_data() const
+    {
+        return nullptr;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Copy a range of bytes from a contiguous block of memory, shared by both the MemoryReader and MappedFile
+    // ---------------------------------------------------------------------------------------------------------------------
+    static size_t _read_from_memory(const uint8_t *p_data, size_t p_size, uint64_t p_offset, void *p_buffer, size_t p_length)
+    {
+        if (p_offset >= p_size)
+        {
+            return 0;
+        }
+
+        size_t length = (size_t)(p_size - p_offset);
+        if (length > p_length)
+        {
+            length = p_length;
+        }
+        std::memcpy(p_buffer, p_data + p_offset, length);
+        return length;
+    }
+
+    MemoryReader::MemoryReader(const uint8_t *p_data, size_t p_size) : _data(p_data), _size(p_size)
+    {
+    }
+
+    uint64_t MemoryReader::get_size() const
+    {
+        return _size;
+    }
+
+    size_t MemoryReader::read(uint64_t p_offset, void *p_buffer, size_t p_length)
+    {
+        return _read_from_memory(_data, _size, p_offset, p_buffer, p_length);
+    }
+
+    const uint8_t *MemoryReader::get_data() const
+    {
+        return _data;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Map the file at the given path into memory, returns a non-zero value if the file could not be mapped
+    // ---------------------------------------------------------------------------------------------------------------------
+    int MappedFile::open(const std::string &p_path)
+    {
+        close();
+
+#if defined(_WIN32)
+        /* Memory-mapping is not implemented for Windows, the caller should fall back to stdio instead */
+        return 1;
+#else
+        int file_descriptor = ::open(p_path.c_str(), O_RDONLY);
+        if (file_descriptor < 0)
+        {
+            return 1;
+        }
+
+        struct stat file_stat;
+        if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size <= 0)
+        {
+            ::close(file_descriptor);
+            return 1;
+        }
+
+        void *data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        /* The mapping keeps its own reference to the file, so the descriptor is no longer needed */
+        ::close(file_descriptor);
+        if (data == MAP_FAILED)
+        {
+            return 1;
+        }
+
+        _data = (const uint8_t *)data;
+        _size = (size_t)file_stat.st_size;
+        return 0;
+#endif
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Unmap the file, any pointers returned by get_data() are invalid afterwards
+    // ---------------------------------------------------------------------------------------------------------------------
+    void MappedFile::close()
+    {
+#if !defined(_WIN32)
+        if (_data != nullptr)
+        {
+            munmap((void *)_data, _size);
+        }
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+
+    uint64_t MappedFile::get_size() const
+    {
+        return _size;
+    }
+
+    size_t MappedFile::read(uint64_t p_offset, void *p_buffer, size_t p_length)
+    {
+        return _read_from_memory(_data, _size, p_offset, p_buffer, p_length);
+    }
+
+    const uint8_t *MappedFile::get_data() const
+    {
+        return _data;
+    }
+
+    bool MappedFile::is_open() const
+    {
+        return _data != nullptr;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Callbacks that allow minizip to read the archive through an ArchiveReader
+    // ---------------------------------------------------------------------------------------------------------------------
+    static voidpf ZCALLBACK _open_reader(voidpf p_opaque, const void * /* p_filename */, int p_mode)
+    {
+        if ((p_mode & ZLIB_FILEFUNC_MODE_WRITE) != 0)
+        {
+            return NULL;
+        }
+
+        ArchiveReaderStream *stream = new ArchiveReaderStream();
+        stream->reader = (ArchiveReader *)p_opaque;
+        stream->position = 0;
+        return stream;
+    }
+
+    static uLong ZCALLBACK _read_reader(voidpf /* p_opaque */, voidpf p_stream, void *p_buffer, uLong p_size)
+    {
+        ArchiveReaderStream *stream = (ArchiveReaderStream *)p_stream;
+        const size_t length = stream->reader->read(stream->position, p_buffer, (size_t)p_size);
+        stream->position += length;
+        return (uLong)length;
+    }
+
+    static uLong ZCALLBACK _write_reader(voidpf /* p_opaque */, voidpf /* p_stream */, const void * /* p_buffer */, uLong /* p_size */)
+    {
+        /* Archives are only ever read! */
+        return 0;
+    }
+
+    static ZPOS64_T ZCALLBACK _tell_reader(voidpf /* p_opaque */, voidpf p_stream)
+    {
+        return ((ArchiveReaderStream *)p_stream)->position;
+    }
+
+    static long ZCALLBACK _seek_reader(voidpf /* p_opaque */, voidpf p_stream, ZPOS64_T p_offset, int p_origin)
+    {
+        ArchiveReaderStream *stream = (ArchiveReaderStream *)p_stream;
+        const uint64_t size = stream->reader->get_size();
+
+        uint64_t position;
+        switch (p_origin)
+        {
+        case ZLIB_FILEFUNC_SEEK_SET:
+            position = p_offset;
+            break;
+        case ZLIB_FILEFUNC_SEEK_CUR:
+            position = stream->position + p_offset;
+            break;
+        case ZLIB_FILEFUNC_SEEK_END:
+            position = size + p_offset;
+            break;
+        default:
+            return -1;
+        }
+
+        if (position > size)
+        {
+            return -1;
+        }
+        stream->position = position;
+        return 0;
+    }
+
+    static int ZCALLBACK _close_reader(voidpf /* p_opaque */, voidpf p_stream)
+    {
+        delete (ArchiveReaderStream *)p_stream;
+        return 0;
+    }
+
+    static int ZCALLBACK _error_reader(voidpf /* p_opaque */, voidpf /* p_stream */)
+    {
+        return 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Fill in the minizip I/O function table so that unzOpen2_64() reads through the given reader
+    // ---------------------------------------------------------------------------------------------------------------------
+    void fill_archive_reader_filefunc(zlib_filefunc64_def *p_filefunc, ArchiveReader *p_reader)
+    {
+        p_filefunc->zopen64_file = _open_reader;
+        p_filefunc->zread_file = _read_reader;
+        p_filefunc->zwrite_file = _write_reader;
+        p_filefunc->ztell64_file = _tell_reader;
+        p_filefunc->zseek64_file = _seek_reader;
+        p_filefunc->zclose_file = _close_reader;
+        p_filefunc->zerror_file = _error_reader;
+        p_filefunc->opaque = p_reader;
+    }
+};
\ No newline at end of file
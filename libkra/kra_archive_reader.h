@@ -0,0 +1,75 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_ARCHIVE_READER_H
+#define KRA_ARCHIVE_READER_H
+
+#include "kra_utility.h"
+
+#include "../zlib/contrib/minizip/ioapi.h"
+
+namespace kra
+{
+    /* This class is the interface through which minizip reads the raw bytes of a KRA/KRZ-archive */
+    /* Implement it to load archives from any other source (e.g. an object store or a caching layer) */
+    /* NOTE: read() can be called from multiple threads at once when layers are extracted in parallel! */
+    class ArchiveReader
+    {
+    public:
+        virtual ~ArchiveReader() = default;
+
+        /* Total size of the archive in bytes */
+        virtual uint64_t get_size() const = 0;
+        /* Copy up to p_length bytes, starting at p_offset, to the buffer and return the number of bytes copied */
+        /* Every opened stream keeps track of its own position, so the reader itself never has to seek! */
+        virtual size_t read(uint64_t p_offset, void *p_buffer, size_t p_length) = 0;
+
+        /* Pointer to the complete archive if it is available as one contiguous block of memory, nullptr otherwise */
+        virtual const uint8_t *get_data() const;
+    };
+
+    /* This class serves an archive straight from a caller-owned memory buffer, which is never copied */
+    class MemoryReader : public ArchiveReader
+    {
+    private:
+        const uint8_t *_data;
+        size_t _size;
+
+    public:
+        MemoryReader(const uint8_t *p_data, size_t p_size);
+
+        uint64_t get_size() const override;
+        size_t read(uint64_t p_offset, void *p_buffer, size_t p_length) override;
+
+        const uint8_t *get_data() const override;
+    };
+
+    /* This class maps a complete KRA/KRZ-archive into memory as to avoid going through stdio for every read */
+    /* The mapping is read-only and stays valid until close() is called or the instance is destroyed */
+    class MappedFile : public ArchiveReader
+    {
+    private:
+        const uint8_t *_data = nullptr;
+        size_t _size = 0;
+
+    public:
+        ~MappedFile();
+
+        int open(const std::string &p_path);
+        void close();
+
+        uint64_t get_size() const override;
+        size_t read(uint64_t p_offset, void *p_buffer, size_t p_length) override;
+
+        const uint8_t *get_data() const override;
+
+        bool is_open() const;
+    };
+
+    void fill_archive_reader_filefunc(zlib_filefunc64_def *p_filefunc, ArchiveReader *p_reader);
+};
+
+#endif // KRA_ARCHIVE_READER_H
\ No newline at end of file
@@ -0,0 +1,87 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_BOUNDED_QUEUE_H
+#define KRA_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace kra
+{
+    /* This class passes items from one thread to another while never holding more than 'capacity' items at once */
+    /* Producers block while the queue is full, consumers block while it is empty and not yet closed */
+    template <typename T>
+    class BoundedQueue
+    {
+    private:
+        std::deque<T> _items;
+        size_t _capacity;
+        bool _is_closed = false;
+
+        std::mutex _mutex;
+        std::condition_variable _not_full;
+        std::condition_variable _not_empty;
+
+    public:
+        BoundedQueue(size_t p_capacity) : _capacity(p_capacity > 0 ? p_capacity : 1) {}
+
+        // -----------------------------------------------------------------------------------------------------------------
+        // Add an item to the back of the queue, returns false if the queue got closed before the item could be added
+        // -----------------------------------------------------------------------------------------------------------------
+        bool push(T p_item)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_full.wait(lock, [this]()
+                           { return _is_closed || _items.size() < _capacity; });
+            if (_is_closed)
+            {
+                return false;
+            }
+
+            _items.push_back(std::move(p_item));
+            lock.unlock();
+            _not_empty.notify_one();
+            return true;
+        }
+
+        // -----------------------------------------------------------------------------------------------------------------
+        // Take the item at the front of the queue, returns false once the queue is closed and all its items are taken
+        // -----------------------------------------------------------------------------------------------------------------
+        bool pop(T &p_item)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_empty.wait(lock, [this]()
+                            { return _is_closed || !_items.empty(); });
+            if (_items.empty())
+            {
+                return false;
+            }
+
+            p_item = std::move(_items.front());
+            _items.pop_front();
+            lock.unlock();
+            _not_full.notify_one();
+            return true;
+        }
+
+        // -----------------------------------------------------------------------------------------------------------------
+        // Stop accepting new items, the items that are still queued can be taken as usual
+        // -----------------------------------------------------------------------------------------------------------------
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _is_closed = true;
+            }
+            _not_full.notify_all();
+            _not_empty.notify_all();
+        }
+    };
+};
+
+#endif // KRA_BOUNDED_QUEUE_H
\ No newline at end of file
@@ -6,27 +6,193 @@
 
 #include "kra_document.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+
 namespace kra
 {
     // ---------------------------------------------------------------------------------------------------------------------
     // Load a KRA/KRZ archive from file and import document properties and layers
     // ---------------------------------------------------------------------------------------------------------------------
-    int Document::load(const std::wstring &p_path)
+    int Document::load(const std::wstring &p_path, const LoadOptions &p_options)
     {
         /* Convert wstring to string */
         std::string string_path = std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(p_path);
         const char *char_path = string_path.c_str();
 
         /* Open the KRA archive using zlib */
-        unzFile file = unzOpen(char_path);
-        if (file == NULL)
+        std::shared_ptr<Archive> archive = std::make_shared<Archive>();
+        if (archive->open(string_path) != 0)
         {
             fprintf(stderr, "ERROR: Failed to open KRA/KRZ archive at path '%s'\n", char_path);
             return 1;
         }
 
+        return _load(archive, char_path, p_options);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Load a KRA/KRZ archive that is already available in memory, the buffer is never copied
+    // NOTE: When loading lazily, the buffer has to stay valid for as long as the document is (re-)loaded or destroyed!
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Document::load_from_memory(const uint8_t *p_data, size_t p_size, const LoadOptions &p_options)
+    {
+        return load_from_reader(std::make_shared<MemoryReader>(p_data, p_size), p_options);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Load a KRA/KRZ archive whose raw bytes are served by the given reader
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Document::load_from_reader(std::shared_ptr<ArchiveReader> p_reader, const LoadOptions &p_options)
+    {
+        std::shared_ptr<Archive> archive = std::make_shared<Archive>();
+        if (archive->open(p_reader) != 0)
+        {
+            fprintf(stderr, "ERROR: Failed to open KRA/KRZ archive from reader\n");
+            return 1;
+        }
+
+        return _load(archive, "<reader>", p_options);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Import document properties and layers from an opened KRA/KRZ archive
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Document::_load(std::shared_ptr<Archive> p_archive, const char *p_source, const LoadOptions &p_options)
+    {
+        /* Any archive that was kept open by a previous (lazy) load isn't needed anymore */
+        _archive.reset();
+        _merged_image_data.clear();
+
+        /* When pipelined, the tile data of a paint layer is already extracted while the rest of 'maindoc.xml' is still being walked */
+        const bool is_pipelined = p_options.load_mode == FULL_LOAD && p_options.extraction_mode == PIPELINED_EXTRACTION;
+        LoadPipeline pipeline(*p_archive, p_options.pipeline_queue_capacity);
+
+        /* The complete layer tree is built while walking 'maindoc.xml', after which the XML-file isn't needed anymore */
+        /* The strings are only handed over to the document together with the layers that point into them */
+        StringArena strings;
+        MaindocVisitor visitor(strings);
+        /* The sizes of the layer entries are known from the central directory, so they're imported as soon as a layer is seen */
+        visitor.on_layer = [&](Layer &p_layer)
+        {
+            p_layer.import_entry_sizes(visitor.name, *p_archive);
+
+            /* Layers that are filtered out later on are never queued, so their entries are never extracted either */
+            if (is_pipelined && p_layer.type == PAINT_LAYER && _is_layer_selected(visitor.get_layer_stack(), p_options.layer_filter))
+            {
+                pipeline.start(visitor.name);
+                pipeline.push(&p_layer);
+            }
+        };
+        const int parse_result = _parse_maindoc(*p_archive, p_source, p_options, visitor);
+        /* All stages have to be drained before the layer tree gets touched again, even when parsing failed */
+        const int pipeline_result = pipeline.finish();
+        if (parse_result != 0)
+        {
+            return 1;
+        }
+        if (pipeline_result != UNZ_OK)
+        {
+            fprintf(stderr, "ERROR: Failed to extract the tile data of one or more layers in archive ('%s')\n", p_source);
+            return 1;
+        }
+
+        /* The pipeline is only started once the first selected paint layer is found */
+        if (pipeline.is_started() && verbosity_level >= VERBOSE)
+        {
+            pipeline.print_report();
+        }
+
+        /* Get important document attributes from the XML-file */
+        width = visitor.width;
+        height = visitor.height;
+        name = visitor.name;
+        /* Each separate layer also has its own color space in KRA, so this color_space isn't really important */
+        color_space = get_color_space(visitor.color_space_name);
+        layers = std::move(visitor.layers);
+        _strings = std::move(strings);
+
+        if (verbosity_level >= VERBOSE)
+        {
+            print_document_attributes();
+            fprintf(stdout, "Interned %zu distinct layer strings using %zu bytes\n", _strings.get_string_count(), _strings.get_memory_usage());
+        }
+
+        /* The merged image is copied as-is, it only gets decoded once it is actually requested */
+        if (p_options.load_merged_image)
+        {
+            EntryData merged_image_data;
+            if (p_archive->extract_entry("mergedimage.png", merged_image_data) == UNZ_OK)
+            {
+                _merged_image_data.assign(merged_image_data.data, merged_image_data.data + merged_image_data.size);
+            }
+            else if (verbosity_level > QUIET)
+            {
+                fprintf(stdout, "WARNING: File 'mergedimage.png' is missing in archive ('%s')\n", p_source);
+            }
+        }
+
+        /* Layers that aren't selected are dropped before anything else happens, so their entries are never extracted */
+        if (!p_options.layer_filter.is_empty())
+        {
+            _filter_layers(p_options.layer_filter);
+        }
+
+        if (verbosity_level >= VERBOSE)
+        {
+            for (auto const &layer : layers)
+            {
+                _print_layer_tree(layer);
+            }
+        }
+
+        /* Only now that the complete layer tree is known, the tile data of every paint layer gets extracted */
+        switch (p_options.load_mode)
+        {
+        case FULL_LOAD:
+            /* A pipelined load already imported all of the tile data while walking */
+            if (!is_pipelined && _import_layer_data(*p_archive, p_options) != UNZ_OK)
+            {
+                fprintf(stderr, "ERROR: Failed to extract the tile data of one or more layers in archive ('%s')\n", p_source);
+                p_archive->close();
+                /* The layer table could still point to the layers of a previous load, which were just replaced */
+                _layer_table.clear();
+                _uuid_index.clear();
+                return 1;
+            }
+            if (verbosity_level >= VERBOSE)
+            {
+                _print_tile_statistics();
+            }
+            /* Close the KRA/KRZ archive */
+            p_archive->close();
+            break;
+        case LAZY_LOAD:
+            /* The KRA/KRZ archive stays open until the document is destroyed or loaded again */
+            _defer_layer_data(p_archive);
+            _archive = p_archive;
+            break;
+        case METADATA_ONLY:
+            /* None of the layer entries are ever touched */
+            p_archive->close();
+            break;
+        }
+
+        _create_layer_table();
+        return 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract 'maindoc.xml' and let the visitor walk it, the XML-file itself is released again before returning
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Document::_parse_maindoc(Archive &p_archive, const char *p_source, const LoadOptions &p_options, MaindocVisitor &p_visitor)
+    {
         /* A 'maindoc.xml' file should always be present in the KRA/KRZ archive, if not return immediately */
-        int errorCode = unzLocateFile(file, "maindoc.xml", 1);
+        EntryData maindoc_data;
+        int errorCode = p_archive.extract_entry("maindoc.xml", maindoc_data);
         if (errorCode == UNZ_OK)
         {
             if (verbosity_level > QUIET)
@@ -36,39 +202,37 @@ namespace kra
         }
         else
         {
-            fprintf(stderr, "ERROR: Required file 'maindoc.xml' is missing in archive ('%s')\n", char_path);
+            fprintf(stderr, "ERROR: Required file 'maindoc.xml' is missing in archive ('%s')\n", p_source);
             return 1;
         }
 
-        std::vector<unsigned char> result_vector;
-        extract_current_file_to_vector(file, result_vector);
+        auto start = std::chrono::steady_clock::now();
 
-        /* Convert the vector into a string and parse it using tinyXML2 */
-        const std::string xml_string(result_vector.begin(), result_vector.end());
-        tinyxml2::XMLDocument xml_document;
-        xml_document.Parse(xml_string.c_str());
+        /* Documents that are loaded in a row can share the same XMLDocument, which lets tinyXML2 re-use its memory pools */
+        std::shared_ptr<tinyxml2::XMLDocument> xml_document = p_options.xml_document;
+        if (xml_document == nullptr)
+        {
+            xml_document = std::make_shared<tinyxml2::XMLDocument>();
+        }
 
-        /* Get important document attributes from the XML-file */
-        const tinyxml2::XMLElement *xml_element = xml_document.FirstChildElement("DOC")->FirstChildElement("IMAGE");
-        width = xml_element->UnsignedAttribute("width", 0);
-        height = xml_element->UnsignedAttribute("height", 0);
-        name = xml_element->Attribute("name");
-        std::string color_space_name = xml_element->Attribute("colorspacename");
-        /* Each separate layer also has its own color space in KRA, so this color_space isn't really important */
-        color_space = get_color_space(color_space_name);
+        /* tinyXML2 always makes its own (null-terminated) copy, so the entry's content is parsed as-is */
+        xml_document->Parse((const char *)maindoc_data.data, maindoc_data.size);
+        xml_document->Accept(&p_visitor);
+        /* All nodes are returned to the memory pools straight away, as the layer tree doesn't need them anymore */
+        xml_document->Clear();
 
         if (verbosity_level >= VERBOSE)
         {
-            print_document_attributes();
+            const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            fprintf(stdout, "Parsed %zu bytes of 'maindoc.xml' in %.3f ms\n", maindoc_data.size, elapsed);
         }
 
-        /* Parse all the layers registered in the maindoc.xml and add them to the document */
-        layers = _parse_layers(file, xml_element);
-    
-        _create_layer_map();
+        if (!p_visitor.has_image())
+        {
+            fprintf(stderr, "ERROR: File 'maindoc.xml' does not describe an image ('%s')\n", p_source);
+            return 1;
+        }
 
-        /* Close the KRA/KRZ archive */
-        errorCode = unzClose(file);
         return 0;
     }
 
@@ -93,23 +257,77 @@ namespace kra
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Get an exported version of the exact layer with the given uuid
+    // Get an exported version of the exact layer with the given uuid, kept for callers of the former 'layer_map'
     // ---------------------------------------------------------------------------------------------------------------------
     std::unique_ptr<ExportedLayer> Document::get_exported_layer_with_uuid(const std::string &p_uuid) const
     {
-        std::unique_ptr<ExportedLayer> exported_layer = std::make_unique<ExportedLayer>();
-
-        if (layer_map.find(p_uuid) != layer_map.end())
+        const LayerHandle handle = find_layer(p_uuid);
+        if (handle == INVALID_LAYER_HANDLE)
         {
-            const std::unique_ptr<Layer> &layer = layer_map.at(p_uuid);
-            exported_layer = layer->get_exported_layer();
+            fprintf(stderr, "ERROR: There's no layer with UUID %s", p_uuid.c_str());
+            return std::make_unique<ExportedLayer>();
         }
-        else
+
+        return get_exported_layer(handle);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get an exported version of the layer with the given handle
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<ExportedLayer> Document::get_exported_layer(LayerHandle p_handle) const
+    {
+        const Layer *layer = get_layer(p_handle);
+        if (layer == nullptr)
         {
-            fprintf(stderr, "ERROR: There's no layer with UUID %s", p_uuid.c_str());
+            fprintf(stderr, "ERROR: Handle %u is out of range, should be less than %zu", p_handle, _layer_table.size());
+            return std::make_unique<ExportedLayer>();
         }
 
-        return exported_layer;
+        return layer->get_exported_layer();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Helper functions for navigating the layer tree through the layer table, invalid handles never cause a crash
+    // ---------------------------------------------------------------------------------------------------------------------
+    size_t Document::get_layer_count() const
+    {
+        return _layer_table.size();
+    }
+
+    const Layer *Document::get_layer(LayerHandle p_handle) const
+    {
+        return (p_handle < _layer_table.size()) ? _layer_table[p_handle].layer : nullptr;
+    }
+
+    LayerHandle Document::find_layer(const Uuid &p_uuid) const
+    {
+        auto it = _uuid_index.find(p_uuid);
+        return (it != _uuid_index.end()) ? it->second : INVALID_LAYER_HANDLE;
+    }
+
+    LayerHandle Document::find_layer(std::string_view p_uuid) const
+    {
+        Uuid uuid;
+        return Uuid::parse(p_uuid, uuid) ? find_layer(uuid) : INVALID_LAYER_HANDLE;
+    }
+
+    LayerHandle Document::get_parent(LayerHandle p_handle) const
+    {
+        return (p_handle < _layer_table.size()) ? _layer_table[p_handle].parent : INVALID_LAYER_HANDLE;
+    }
+
+    size_t Document::get_child_count(LayerHandle p_handle) const
+    {
+        return (p_handle < _layer_table.size()) ? _layer_table[p_handle].child_count : 0;
+    }
+
+    LayerHandle Document::get_child(LayerHandle p_handle, size_t p_index) const
+    {
+        if (p_index >= get_child_count(p_handle))
+        {
+            return INVALID_LAYER_HANDLE;
+        }
+        return _layer_table[p_handle].first_child + (LayerHandle)p_index;
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
@@ -133,6 +351,54 @@ namespace kra
         return exported_layers;
     }
 
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decode the pre-flattened image that Krita stores in every archive, without touching any of the layers
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<ExportedLayer> Document::get_merged_image() const
+    {
+        std::unique_ptr<ExportedLayer> exported_layer = std::make_unique<ExportedLayer>();
+        exported_layer->name = "mergedimage";
+        exported_layer->x = 0;
+        exported_layer->y = 0;
+        exported_layer->opacity = 255;
+        exported_layer->visible = true;
+        exported_layer->type = PAINT_LAYER;
+        exported_layer->color_space = RGBA;
+        exported_layer->top = 0;
+        exported_layer->left = 0;
+        exported_layer->bottom = 0;
+        exported_layer->right = 0;
+        exported_layer->pixel_size = 0;
+
+        /* Lazily loaded documents still have their archive opened, so the PNG-file can be extracted right now */
+        EntryData entry_data;
+        if (_merged_image_data.empty() && _archive != nullptr)
+        {
+            _archive->extract_entry("mergedimage.png", entry_data);
+        }
+        const uint8_t *data = _merged_image_data.empty() ? entry_data.data : _merged_image_data.data();
+        const size_t size = _merged_image_data.empty() ? entry_data.size : _merged_image_data.size();
+        if (data == nullptr)
+        {
+            fprintf(stderr, "ERROR: Merged image is not available, load the document with 'load_merged_image' enabled\n");
+            return exported_layer;
+        }
+
+        unsigned int image_width;
+        unsigned int image_height;
+        if (decode_png(data, size, image_width, image_height, exported_layer->data) != 0)
+        {
+            fprintf(stderr, "ERROR: Failed to decode 'mergedimage.png'\n");
+            exported_layer->data.clear();
+            return exported_layer;
+        }
+
+        exported_layer->bottom = (int32_t)image_height;
+        exported_layer->right = (int32_t)image_width;
+        exported_layer->pixel_size = 4;
+        return exported_layer;
+    }
+
     // ---------------------------------------------------------------------------------------------------------------------
     // Print document attributes to the output console
     // ---------------------------------------------------------------------------------------------------------------------
@@ -146,86 +412,309 @@ namespace kra
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Go through the XML-file and extract all the layer properties.
+    // Remove all layers that aren't selected by the filter, except for the group layers that contain selected layers
     // ---------------------------------------------------------------------------------------------------------------------
-    std::vector<std::unique_ptr<Layer>> Document::_parse_layers(unzFile &p_file, const tinyxml2::XMLElement *xmlElement)
+    void Document::_filter_layers(const LayerFilter &p_filter)
     {
-        std::vector<std::unique_ptr<Layer>> layers;
-        const tinyxml2::XMLElement *layers_element = xmlElement->FirstChildElement("layers");
-        const tinyxml2::XMLElement *layer_node = layers_element->FirstChild()->ToElement();
-        
+        const size_t paint_layer_count = _get_paint_layers().size();
+
+        layers.erase(std::remove_if(layers.begin(), layers.end(), [&](const std::unique_ptr<Layer> &layer)
+                                    { return !_filter_layer(layer, p_filter, ""); }),
+                     layers.end());
+
         if (verbosity_level >= VERBOSE)
         {
-            fprintf(stdout, "Recursively extracting layer attributes and data from 'maindoc.xml'...\n");
+            fprintf(stdout, "Layer filter selected %zu out of %zu paint layers\n", _get_paint_layers().size(), paint_layer_count);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Recursively filter the children of this layer, returns whether the layer itself should be kept
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool Document::_filter_layer(const std::unique_ptr<Layer> &layer, const LayerFilter &p_filter, const std::string &p_parent_path)
+    {
+        std::string path = p_parent_path;
+        if (!path.empty())
+        {
+            path += "/";
+        }
+        path += layer->name;
+
+        /* A selected group layer is kept as a whole */
+        if (p_filter.matches(*layer, path))
+        {
+            return true;
+        }
+
+        std::vector<std::unique_ptr<Layer>> &children = layer->children;
+        children.erase(std::remove_if(children.begin(), children.end(), [&](const std::unique_ptr<Layer> &child)
+                                      { return !_filter_layer(child, p_filter, path); }),
+                       children.end());
+
+        /* Otherwise a group layer is only kept when it still has children left, as to keep the tree consistent */
+        return !children.empty();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Check whether the layer at the back of the stack gets selected by the filter, either by itself or through an ancestor
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool Document::_is_layer_selected(const std::vector<Layer *> &p_layer_stack, const LayerFilter &p_filter) const
+    {
+        if (p_filter.is_empty())
+        {
+            return true;
         }
 
-        /* Hopefully we find something... otherwise there are no layers! */
-        /* Keep trying to find a layer until we can't find any new ones! */
-        while (layer_node != 0)
+        /* Identical to _filter_layer(), as a selected group layer keeps all of its children */
+        std::string path;
+        for (const Layer *layer : p_layer_stack)
         {
-            /* Check the type of the layer and proceed from there... */
-            std::string node_type = layer_node->Attribute("nodetype");
-            std::unique_ptr<Layer> layer = std::make_unique<Layer>();
-            /* If it is not a paintlayer nor a grouplayer then we don't support it! */
-            if (node_type == "paintlayer" || node_type == "grouplayer")
+            if (!path.empty())
             {
-                if (node_type == "paintlayer")
-                {
-                    layer->type = PAINT_LAYER;
-                }
-                else
-                {
-                    layer->type = GROUP_LAYER;
-                }
+                path += "/";
+            }
+            path += layer->name;
+            if (p_filter.matches(*layer, path))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
 
-                layer->import_attributes(name, p_file, layer_node);
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract the tile data of all paint layers, either one after another or concurrently
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Document::_import_layer_data(Archive &p_archive, const LoadOptions &p_options)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        /* The paint layers are gathered in document order, which is also the order in which they are extracted */
+        const std::vector<Layer *> paint_layers = _get_paint_layers();
 
-                if (verbosity_level >= VERBOSE)
+        int error_code = UNZ_OK;
+        unsigned int used_thread_count = 1;
+        switch (p_options.extraction_mode)
+        {
+        case SEQUENTIAL_EXTRACTION:
+        /* NOTE: Pipelined loads already imported their tile data, this is only here for completeness! */
+        case PIPELINED_EXTRACTION:
+            for (Layer *layer : paint_layers)
+            {
+                if (layer->import_layer_data(name, p_archive) != UNZ_OK)
                 {
-                    layer->print_layer_attributes();
+                    error_code = UNZ_ERRNO;
                 }
+            }
+            break;
+        case PARALLEL_EXTRACTION:
+            used_thread_count = std::min(get_thread_count(), (unsigned int)std::max(paint_layers.size(), (size_t)1));
+            error_code = _import_layer_data_in_parallel(p_archive, paint_layers);
+            break;
+        }
 
-                layers.push_back(std::move(layer));
+        if (verbosity_level >= VERBOSE)
+        {
+            const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            fprintf(stdout, "Extracted %zu layer entries using %u thread(s) in %.3f ms\n", paint_layers.size(), used_thread_count, elapsed);
+        }
+
+        return error_code;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Let multiple worker threads inflate and import the layer entries, each of them reading through its own archive handle
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Document::_import_layer_data_in_parallel(Archive &p_archive, const std::vector<Layer *> &p_paint_layers)
+    {
+        const size_t worker_count = std::min((size_t)get_thread_count(), p_paint_layers.size());
+        if (worker_count == 0)
+        {
+            return UNZ_OK;
+        }
+
+        /* minizip handles can't be shared between threads, so every worker gets its own */
+        /* The first worker can simply re-use the handle that is already opened */
+        std::vector<std::unique_ptr<Archive>> worker_archives;
+        for (size_t i = 1; i < worker_count; i++)
+        {
+            std::unique_ptr<Archive> worker_archive = std::make_unique<Archive>();
+            if (worker_archive->open(p_archive) != 0)
+            {
+                fprintf(stderr, "ERROR: Failed to open an additional handle to the KRA/KRZ archive\n");
+                return UNZ_ERRNO;
             }
+            worker_archives.push_back(std::move(worker_archive));
+        }
 
-            /* Try to get the next layer entry... if not available break */
-            const tinyxml2::XMLNode *nextSibling = layer_node->NextSibling();
-            if (nextSibling == 0)
+        /* Every layer already has its place in the layer tree, so the extracted data automatically ends up in document order */
+        std::atomic<size_t> next_index(0);
+        std::atomic<int> error_code(UNZ_OK);
+        std::vector<std::exception_ptr> exceptions(worker_count);
+
+        auto work = [&](size_t p_worker_index, Archive &p_worker_archive)
+        {
+            try
+            {
+                size_t index;
+                while ((index = next_index++) < p_paint_layers.size())
+                {
+                    if (p_paint_layers[index]->import_layer_data(name, p_worker_archive) != UNZ_OK)
+                    {
+                        error_code = UNZ_ERRNO;
+                    }
+                }
+            }
+            catch (...)
             {
-                break;
+                exceptions[p_worker_index] = std::current_exception();
+                /* Make sure that the other workers stop as soon as possible */
+                next_index = p_paint_layers.size();
             }
-            else
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < worker_count; i++)
+        {
+            threads.emplace_back(work, i, std::ref(*worker_archives[i - 1]));
+        }
+        work(0, p_archive);
+
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+
+        /* Exceptions are re-thrown on the calling thread, identical to a sequential extraction */
+        for (auto const &exception : exceptions)
+        {
+            if (exception)
             {
-                layer_node = nextSibling->ToElement();
+                std::rethrow_exception(exception);
             }
         }
 
-        return layers;
+        return error_code;
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Create the layer_map as to easily find layers by their UUID
+    // Let all paint layers extract their tile data from the (still opened) archive when they are first needed
     // ---------------------------------------------------------------------------------------------------------------------
-    void Document::_create_layer_map()
+    void Document::_defer_layer_data(std::shared_ptr<Archive> p_archive)
     {
-        layer_map.clear();
-        /* Go through all the layers and add them to the map */
+        const std::vector<Layer *> paint_layers = _get_paint_layers();
+
+        /* Every layer refers to the same interned copy of the document name instead of holding its own */
+        const std::string_view document_name = _strings.intern(name);
+        for (Layer *layer : paint_layers)
+        {
+            layer->defer_layer_data(document_name, p_archive);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Gather all paint layers (also those inside of groups) in document order
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::vector<Layer *> Document::_get_paint_layers() const
+    {
+        std::vector<Layer *> paint_layers;
         for (auto const &layer : layers)
         {
-            _add_layer_to_map(layer);
+            _collect_paint_layers(layer, paint_layers);
+        }
+        return paint_layers;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Recursively gather all paint layers (also those inside of groups) in document order
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Document::_collect_paint_layers(const std::unique_ptr<Layer> &layer, std::vector<Layer *> &p_paint_layers) const
+    {
+        if (layer->type == PAINT_LAYER)
+        {
+            p_paint_layers.push_back(layer.get());
+        }
+        for (auto const &child : layer->children)
+        {
+            _collect_paint_layers(child, p_paint_layers);
         }
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Recursively add all child layers (and those children's children) to the layer_map
+    // Recursively print the attributes of this layer and its children, children being printed before their parent
     // ---------------------------------------------------------------------------------------------------------------------
-    void Document::_add_layer_to_map(const std::unique_ptr<Layer> &layer)
+    void Document::_print_layer_tree(const std::unique_ptr<Layer> &layer) const
     {
-        layer_map.insert({layer->uuid, layer});
-        /* Also add all the children of this layer to the map */
         for (auto const &child : layer->children)
         {
-            _add_layer_to_map(child);
+            _print_layer_tree(child);
+        }
+        layer->print_layer_attributes();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Print how many of the tiles of all paint layers are unique & how many are uniform, as only the unique tiles that
+    // aren't uniform actually get decoded
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Document::_print_tile_statistics() const
+    {
+        size_t tile_count = 0;
+        size_t unique_tile_count = 0;
+        size_t uniform_tile_count = 0;
+        for (const Layer *layer : _get_paint_layers())
+        {
+            /* NOTE: The layer data is accessed directly, as to never trigger an extraction when loading lazily */
+            if (layer->layer_data != nullptr)
+            {
+                tile_count += layer->layer_data->get_tile_count();
+                unique_tile_count += layer->layer_data->get_unique_tile_count();
+                uniform_tile_count += layer->layer_data->get_uniform_tile_count();
+            }
+        }
+
+        const double dedupe_ratio = (unique_tile_count > 0) ? (double)tile_count / unique_tile_count : 1.0;
+        fprintf(stdout, "Found %zu unique tiles out of %zu tiles (dedupe ratio %.2f)\n", unique_tile_count, tile_count, dedupe_ratio);
+        fprintf(stdout, "Found %zu uniform tiles, which are filled instead of decoded\n", uniform_tile_count);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Create the layer table as to easily navigate the layer tree and find layers by their UUID
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Document::_create_layer_table()
+    {
+        _layer_table.clear();
+        _uuid_index.clear();
+
+        /* The top-level layers get the first handles, which are identical to their index in the layers vector */
+        for (auto const &layer : layers)
+        {
+            _layer_table.push_back({layer.get(), Uuid(), INVALID_LAYER_HANDLE, INVALID_LAYER_HANDLE, 0});
+        }
+
+        /* Going through the table breadth-first guarantees that all the children of a layer are added right after each other */
+        for (LayerHandle handle = 0; handle < (LayerHandle)_layer_table.size(); handle++)
+        {
+            Layer *layer = _layer_table[handle].layer;
+            layer->handle = handle;
+
+            /* The UUID is only parsed once, all lookups afterwards are done on its 128-bit value */
+            if (Uuid::parse(layer->uuid, _layer_table[handle].uuid))
+            {
+                /* Just like before, the first layer with a certain UUID is the one that gets found */
+                _uuid_index.emplace(_layer_table[handle].uuid, handle);
+            }
+            else if (verbosity_level > QUIET)
+            {
+                fprintf(stdout, "WARNING: Layer with name '%.*s' has a malformed UUID '%.*s'\n", (int)layer->name.size(), layer->name.data(), (int)layer->uuid.size(), layer->uuid.data());
+            }
+
+            _layer_table[handle].first_child = (LayerHandle)_layer_table.size();
+            _layer_table[handle].child_count = (uint32_t)layer->children.size();
+            for (auto const &child : layer->children)
+            {
+                _layer_table.push_back({child.get(), Uuid(), handle, INVALID_LAYER_HANDLE, 0});
+            }
         }
     }
 };
\ No newline at end of file
@@ -9,8 +9,15 @@
 
 #include "kra_utility.h"
 
+#include "kra_archive.h"
+#include "kra_load_options.h"
+#include "kra_load_pipeline.h"
 #include "kra_layer.h"
+#include "kra_layer_sampler.h"
+#include "kra_maindoc_visitor.h"
 #include "kra_exported_layer.h"
+#include "kra_png.h"
+#include "kra_uuid.h"
 
 #include "../tinyxml2/tinyxml2.h"
 #include "../zlib/contrib/minizip/unzip.h"
@@ -21,14 +28,51 @@
 
 namespace kra
 {
+	/* This class stores where a single layer can be found in the layer tree, its index in the layer table is its LayerHandle */
+	class LayerTableEntry
+	{
+	public:
+		Layer *layer;
+		Uuid uuid;
+
+		LayerHandle parent;
+		/* The children of a layer always have consecutive handles, so they don't need a vector of their own */
+		LayerHandle first_child;
+		uint32_t child_count;
+	};
+
 	/* This class stores the general properties of a KRA/KRZ-archive as well as a vector of layers containing the actual data */
 	class Document
 	{
 	private:
-		std::vector<std::unique_ptr<Layer>> _parse_layers(unzFile &p_file, const tinyxml2::XMLElement *xmlElement);
+		/* Only kept open when the document is loaded lazily (= LAZY_LOAD) */
+		std::shared_ptr<Archive> _archive;
+		/* Only filled when the document is loaded with LoadOptions::load_merged_image */
+		std::vector<uint8_t> _merged_image_data;
+		/* All strings of the layers (names, filenames and UUIDs) point into this arena */
+		StringArena _strings;
+
+		int _load(std::shared_ptr<Archive> p_archive, const char *p_source, const LoadOptions &p_options);
+		int _parse_maindoc(Archive &p_archive, const char *p_source, const LoadOptions &p_options, MaindocVisitor &p_visitor);
+
+		void _filter_layers(const LayerFilter &p_filter);
+		bool _filter_layer(const std::unique_ptr<Layer> &layer, const LayerFilter &p_filter, const std::string &p_parent_path);
+		bool _is_layer_selected(const std::vector<Layer *> &p_layer_stack, const LayerFilter &p_filter) const;
 
-		void _create_layer_map();
-		void _add_layer_to_map(const std::unique_ptr<Layer> &layer);
+		int _import_layer_data(Archive &p_archive, const LoadOptions &p_options);
+		void _defer_layer_data(std::shared_ptr<Archive> p_archive);
+		int _import_layer_data_in_parallel(Archive &p_archive, const std::vector<Layer *> &p_paint_layers);
+		std::vector<Layer *> _get_paint_layers() const;
+		void _collect_paint_layers(const std::unique_ptr<Layer> &layer, std::vector<Layer *> &p_paint_layers) const;
+
+		void _print_layer_tree(const std::unique_ptr<Layer> &layer) const;
+		void _print_tile_statistics() const;
+
+		/* Every layer of the tree (breadth-first, so the top-level layers come first) in a single contiguous vector */
+		std::vector<LayerTableEntry> _layer_table;
+		std::unordered_map<Uuid, LayerHandle, UuidHash> _uuid_index;
+
+		void _create_layer_table();
 
 	public:
 		std::string name;
@@ -40,15 +84,26 @@ namespace kra
 
 		std::vector<std::unique_ptr<Layer>> layers;
 
-		std::unordered_map<std::string, const std::unique_ptr<Layer> &> layer_map;
-
-		int load(const std::wstring &p_path);
+		int load(const std::wstring &p_path, const LoadOptions &p_options = LoadOptions());
+		int load_from_memory(const uint8_t *p_data, size_t p_size, const LoadOptions &p_options = LoadOptions());
+		int load_from_reader(std::shared_ptr<ArchiveReader> p_reader, const LoadOptions &p_options = LoadOptions());
 
 		std::unique_ptr<ExportedLayer> get_exported_layer_at(int p_layer_index) const;
 		std::unique_ptr<ExportedLayer> get_exported_layer_with_uuid(const std::string &p_uuid) const;
+		std::unique_ptr<ExportedLayer> get_exported_layer(LayerHandle p_handle) const;
+
+		size_t get_layer_count() const;
+		const Layer *get_layer(LayerHandle p_handle) const;
+		LayerHandle find_layer(const Uuid &p_uuid) const;
+		LayerHandle find_layer(std::string_view p_uuid) const;
+		LayerHandle get_parent(LayerHandle p_handle) const;
+		size_t get_child_count(LayerHandle p_handle) const;
+		LayerHandle get_child(LayerHandle p_handle, size_t p_index) const;
 
 		std::vector<std::unique_ptr<ExportedLayer>> get_all_exported_layers() const;
 
+		std::unique_ptr<ExportedLayer> get_merged_image() const;
+
 		void print_document_attributes() const;
 	};
 };
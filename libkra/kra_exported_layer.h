@@ -7,15 +7,21 @@
 #ifndef KRA_EXPORTED_LAYER_H
 #define KRA_EXPORTED_LAYER_H
 
+#include "kra_utility.h"
+
+#include <string>
+
 namespace kra
 {
     // This class represents an exported version of a Layer */
     /* In the case of a PAINT_LAYER, this class stores the decompressed data of the entire layer */
     /* In the case of a GROUP_LAYER, this class stores a vector of UUIDs of its child layers */
+    /* NOTE: The name and UUIDs are copied, so an ExportedLayer stays valid after its Document is reloaded or destroyed */
     class ExportedLayer
     {
     public:
         std::string name;
+        LayerHandle handle = INVALID_LAYER_HANDLE;
 
         unsigned int x;
         unsigned int y;
@@ -39,6 +45,8 @@ namespace kra
 
         // GROUP_LAYER
         std::vector<std::string> child_uuids;
+        /* Identical to child_uuids, but these can be passed to Document::get_exported_layer() without any lookup */
+        std::vector<LayerHandle> child_handles;
     };
 };
 
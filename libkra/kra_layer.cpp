@@ -11,12 +11,13 @@ namespace kra
     // ---------------------------------------------------------------------------------------------------------------------
     // Extract important common attributes as stored in this layer's XML element
     // ---------------------------------------------------------------------------------------------------------------------
-    void Layer::import_attributes(const std::string &p_name, unzFile &p_file, const tinyxml2::XMLElement *p_xml_element)
+    void Layer::import_attributes(const tinyxml2::XMLElement *p_xml_element, StringArena &p_strings)
     {
         /* Get important layer attributes from the XML-file */
-        filename = p_xml_element->Attribute("filename");
-        name = p_xml_element->Attribute("name");
-        uuid = p_xml_element->Attribute("uuid");
+        /* These strings are only copied once, as every distinct string is interned by the arena */
+        filename = p_strings.intern(p_xml_element->Attribute("filename"));
+        name = p_strings.intern(p_xml_element->Attribute("name"));
+        uuid = p_strings.intern(p_xml_element->Attribute("uuid"));
 
         x = p_xml_element->UnsignedAttribute("x", 0);
         y = p_xml_element->UnsignedAttribute("y", 0);
@@ -24,31 +25,106 @@ namespace kra
 
         visible = p_xml_element->BoolAttribute("visible", true);
 
-        switch (type)
+        /* NOTE: Child layers of a GROUP_LAYER are added by whoever walks the XML-file! */
+        if (type == PAINT_LAYER)
         {
-        case PAINT_LAYER:
-            _import_paint_attributes(p_name, p_file, p_xml_element);
-            break;
-        case GROUP_LAYER:
-            _import_group_attributes(p_name, p_file, p_xml_element);
-            break;
+            _import_paint_attributes(p_xml_element);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract this layer's tile data from the archive and create a LayerData-instance (only applicable to PAINT_LAYER)
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Layer::import_layer_data(const std::string &p_name, Archive &p_archive)
+    {
+        return _import_layer_data(p_name, p_archive);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract this layer's entry (and its default pixel) without importing it, which allows both steps to happen on
+    // different threads. The default pixel is left empty if the archive doesn't contain one.
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Layer::extract_layer_entry(const std::string &p_name, Archive &p_archive, EntryData &p_result, EntryData &p_default_pixel) const
+    {
+        /* Try and find the relevant file that defines this layer's tile data */
+        /* This also automatically decrypts the tile data */
+        const std::string &layer_path = _get_layer_path(p_name);
+        int errorCode = p_archive.extract_entry(layer_path, p_result);
+        if (errorCode != UNZ_OK)
+        {
+            fprintf(stdout, "ERROR: Layer entry with path '%s' could not be found in KRA archive.\n", layer_path.c_str());
+            return errorCode;
+        }
+
+        /* Older documents don't have a '.defaultpixel'-entry, in which case every pixel without a tile is transparent */
+        const std::string default_pixel_path = layer_path + ".defaultpixel";
+        if (p_archive.find_entry(default_pixel_path) != nullptr && p_archive.extract_entry(default_pixel_path, p_default_pixel) != UNZ_OK)
+        {
+            if (verbosity_level > QUIET)
+            {
+                fprintf(stdout, "WARNING: Default pixel with path '%s' could not be extracted, it is ignored.\n", default_pixel_path.c_str());
+            }
+            p_default_pixel = EntryData();
+        }
+
+        return errorCode;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Create a LayerData-instance from an entry that was extracted beforehand by extract_layer_entry(), taking over its content
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Layer::import_layer_data(EntryData &&p_layer_content, const EntryData &p_default_pixel)
+    {
+        _import_layer_data(std::move(p_layer_content), p_default_pixel);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Remember where this layer's tile data can be found, so that it can be extracted once it is actually needed
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Layer::defer_layer_data(std::string_view p_name, std::shared_ptr<Archive> p_archive)
+    {
+        _document_name = p_name;
+        _archive = p_archive;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Look up the (compressed & uncompressed) size of this layer's entry in the archive's central directory
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Layer::import_entry_sizes(const std::string &p_name, const Archive &p_archive)
+    {
+        if (type != PAINT_LAYER)
+        {
+            return;
+        }
+
+        const ArchiveEntry *entry = p_archive.find_entry(_get_layer_path(p_name));
+        if (entry != nullptr)
+        {
+            compressed_size = entry->compressed_size;
+            uncompressed_size = entry->uncompressed_size;
         }
     }
 
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get this layer's tile data, extracting it from the archive first if it was deferred
+    // ---------------------------------------------------------------------------------------------------------------------
+    const LayerData *Layer::get_layer_data() const
+    {
+        if (_archive != nullptr)
+        {
+            std::call_once(_layer_data_flag, [this]()
+                           { _import_layer_data(std::string(_document_name), *_archive); });
+        }
+
+        return layer_data.get();
+    }
+
     // ---------------------------------------------------------------------------------------------------------------------
     // Get an exported version of this layer that can be used by other (external) programs & wrappers
     // ---------------------------------------------------------------------------------------------------------------------
     std::unique_ptr<ExportedLayer> Layer::get_exported_layer() const
     {
-        std::unique_ptr<ExportedLayer> exported_layer = std::make_unique<ExportedLayer>();
-
-        /* Copy all important properties immediately */
-        exported_layer->name = name;
-        exported_layer->x = x;
-        exported_layer->y = y;
-        exported_layer->opacity = opacity;
-        exported_layer->visible = visible;
-        exported_layer->type = type;
+        std::unique_ptr<ExportedLayer> exported_layer = _get_exported_properties();
 
         switch (type)
         {
@@ -56,20 +132,33 @@ namespace kra
         {
             exported_layer->color_space = color_space;
 
-            exported_layer->top = layer_data->get_top();
-            exported_layer->left = layer_data->get_left();
-            exported_layer->bottom = layer_data->get_bottom();
-            exported_layer->right = layer_data->get_right();
+            const LayerData *data = get_layer_data();
+            if (data == nullptr)
+            {
+                /* Without tile data the layer is exported as being completely empty */
+                exported_layer->top = 0;
+                exported_layer->left = 0;
+                exported_layer->bottom = 0;
+                exported_layer->right = 0;
+                exported_layer->pixel_size = 0;
+                break;
+            }
+
+            exported_layer->top = data->get_top();
+            exported_layer->left = data->get_left();
+            exported_layer->bottom = data->get_bottom();
+            exported_layer->right = data->get_right();
 
-            exported_layer->pixel_size = layer_data->pixel_size;
+            exported_layer->pixel_size = data->pixel_size;
 
-            exported_layer->data = layer_data->get_composed_data(color_space);
+            exported_layer->data = data->get_composed_data(color_space);
             break;
         }
         case GROUP_LAYER:
             for (auto const &child : children)
             {
-                exported_layer->child_uuids.push_back(child->uuid);
+                exported_layer->child_uuids.emplace_back(child->uuid);
+                exported_layer->child_handles.push_back(child->handle);
             }
             break;
         }
@@ -77,15 +166,47 @@ namespace kra
         return exported_layer;
     }
 
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get an exported version of only a rectangular part of this layer, in the same coordinates as the exported layer's
+    // extents (= top, left, bottom & right). Only the tiles overlapping the rectangle get decompressed.
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<ExportedLayer> Layer::get_exported_region(int32_t p_x, int32_t p_y, unsigned int p_width, unsigned int p_height) const
+    {
+        /* Group layers don't have any pixels of their own */
+        if (type != PAINT_LAYER)
+        {
+            return get_exported_layer();
+        }
+
+        std::unique_ptr<ExportedLayer> exported_layer = _get_exported_properties();
+        exported_layer->color_space = color_space;
+        exported_layer->top = p_y;
+        exported_layer->left = p_x;
+        exported_layer->bottom = p_y + (int32_t)p_height;
+        exported_layer->right = p_x + (int32_t)p_width;
+
+        const LayerData *data = get_layer_data();
+        if (data == nullptr)
+        {
+            /* Without tile data the region is exported as being completely empty */
+            exported_layer->pixel_size = 0;
+            return exported_layer;
+        }
+
+        exported_layer->pixel_size = data->pixel_size;
+        exported_layer->data = data->get_composed_region(p_x, p_y, p_width, p_height, color_space);
+        return exported_layer;
+    }
+
     // ---------------------------------------------------------------------------------------------------------------------
     // Print layer attributes to the output console
     // ---------------------------------------------------------------------------------------------------------------------
     void Layer::print_layer_attributes() const
     {
-        fprintf(stdout, "----- Layer with name '%s' contains following values:\n", name.c_str());
-        fprintf(stdout, "   >> filename = %s\n", filename.c_str());
-        fprintf(stdout, "   >> name = %s\n", name.c_str());
-        fprintf(stdout, "   >> uuid = %s\n", uuid.c_str());
+        fprintf(stdout, "----- Layer with name '%.*s' contains following values:\n", (int)name.size(), name.data());
+        fprintf(stdout, "   >> filename = %.*s\n", (int)filename.size(), filename.data());
+        fprintf(stdout, "   >> name = %.*s\n", (int)name.size(), name.data());
+        fprintf(stdout, "   >> uuid = %.*s\n", (int)uuid.size(), uuid.data());
         fprintf(stdout, "   >> x = %i\n", x);
         fprintf(stdout, "   >> y = %i\n", y);
         fprintf(stdout, "   >> opacity = %i\n", opacity);
@@ -104,81 +225,81 @@ namespace kra
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Extract attributes specific to this layer's type (= PAINT_LAYER) and create a LayerData-instance
+    // Extract attributes specific to this layer's type (= PAINT_LAYER), the tile data itself is imported separately
     // ---------------------------------------------------------------------------------------------------------------------
-    void Layer::_import_paint_attributes(const std::string &p_name, unzFile &p_file, const tinyxml2::XMLElement *p_xml_element)
+    void Layer::_import_paint_attributes(const tinyxml2::XMLElement *p_xml_element)
     {
         std::string color_space_name = p_xml_element->Attribute("colorspacename");
         /* The color space defines the number of 'channels' */
         /* Each seperate layer can have its own color space in KRA, but this doesn't seem to used by default */
         color_space = get_color_space(color_space_name);
+    }
 
-        /* Try and find the relevant file that defines this layer's tile data */
-        /* This also automatically decrypts the tile data */
-        /* The "Sample/"-folder is hard-coded as I have yet to encounter a case where this folder is named differently! */
-        const std::string &layer_path = p_name + "/layers/" + filename;
-        std::vector<unsigned char> layer_content;
-        const char *c_path = layer_path.c_str();
-        int errorCode = unzLocateFile(p_file, c_path, 1);
-        errorCode += extract_current_file_to_vector(p_file, layer_content);
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract the tile data from the archive, the data is stored in the (mutable) layer_data as this can happen lazily
+    // ---------------------------------------------------------------------------------------------------------------------
+    int Layer::_import_layer_data(const std::string &p_name, Archive &p_archive) const
+    {
+        if (type != PAINT_LAYER)
+        {
+            return UNZ_OK;
+        }
+
+        EntryData layer_content;
+        EntryData default_pixel;
+        int errorCode = extract_layer_entry(p_name, p_archive, layer_content, default_pixel);
         if (errorCode == UNZ_OK)
         {
-            /* Start extracting the tile data. */
-            layer_data = std::make_unique<LayerData>();
-            layer_data->import_attributes(layer_content);
+            _import_layer_data(std::move(layer_content), default_pixel);
         }
-        else
+
+        return errorCode;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Import the tiles of an already extracted entry, which is moved into the (mutable) layer_data
+    // ---------------------------------------------------------------------------------------------------------------------
+    void Layer::_import_layer_data(EntryData &&p_layer_content, const EntryData &p_default_pixel) const
+    {
+        /* Start extracting the tile data. */
+        std::unique_ptr<LayerData> imported_layer_data = std::make_unique<LayerData>();
+        /* The entry's content is handed over as a whole, so that the tiles can point into it without copying */
+        imported_layer_data->import_attributes(std::move(p_layer_content));
+        if (p_default_pixel.data != nullptr)
         {
-            fprintf(stdout, "ERROR: Layer entry with path '%s' could not be found in KRA archive.\n", layer_path.c_str());
+            imported_layer_data->import_default_pixel(p_default_pixel.data, p_default_pixel.size);
         }
+        layer_data = std::move(imported_layer_data);
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Extract attributes specific to this layer's type (= GROUP_LAYER) and recursively import child layers
+    // Create an exported layer that only has the properties shared by every type of layer filled in
     // ---------------------------------------------------------------------------------------------------------------------
-    void Layer::_import_group_attributes(const std::string &p_name, unzFile &p_file, const tinyxml2::XMLElement *p_xml_element)
+    std::unique_ptr<ExportedLayer> Layer::_get_exported_properties() const
     {
-        const tinyxml2::XMLElement *layers_element = p_xml_element->FirstChildElement("layers");
-        const tinyxml2::XMLNode *first_child = layers_element->FirstChild();
-        const tinyxml2::XMLElement *layer_node = (first_child != 0) ? first_child->ToElement() : 0;
+        std::unique_ptr<ExportedLayer> exported_layer = std::make_unique<ExportedLayer>();
 
-        while (layer_node != 0)
-        {
-            /* Check the type of the layer and proceed from there... */
-            std::string node_type = layer_node->Attribute("nodetype");
-            std::unique_ptr<Layer> layer = std::make_unique<Layer>();
-            if (node_type == "paintlayer" || node_type == "grouplayer")
-            {
-                if (node_type == "paintlayer")
-                {
-                    layer->type = PAINT_LAYER;
-                }
-                else
-                {
-                    layer->type = GROUP_LAYER;
-                }
-
-                layer->import_attributes(p_name, p_file, layer_node);
-
-                if (verbosity_level >= VERBOSE)
-                {
-                    layer->print_layer_attributes();
-                }
-
-                children.push_back(std::move(layer));
-            }
+        /* Copy all important properties immediately */
+        exported_layer->name = std::string(name);
+        exported_layer->handle = handle;
+        exported_layer->x = x;
+        exported_layer->y = y;
+        exported_layer->opacity = opacity;
+        exported_layer->visible = visible;
+        exported_layer->type = type;
 
-            /* Try to get the next layer entry... if not available break */
-            const tinyxml2::XMLNode *nextSibling = layer_node->NextSibling();
-            if (nextSibling == 0)
-            {
-                break;
-            }
-            else
-            {
-                layer_node = nextSibling->ToElement();
-            }
-        }
+        return exported_layer;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the path of the archive entry that contains this layer's tile data
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::string Layer::_get_layer_path(const std::string &p_name) const
+    {
+        /* The "Sample/"-folder is hard-coded as I have yet to encounter a case where this folder is named differently! */
+        std::string layer_path = p_name + "/layers/";
+        layer_path += filename;
+        return layer_path;
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
@@ -188,6 +309,8 @@ namespace kra
     {
         fprintf(stdout, "   -- Additional attributes specific to this layer's type (= PAINT_LAYER):\n");
         fprintf(stdout, "   >> color_space = %i\n", color_space);
+        fprintf(stdout, "   >> compressed_size = %llu\n", (unsigned long long)compressed_size);
+        fprintf(stdout, "   >> uncompressed_size = %llu\n", (unsigned long long)uncompressed_size);
         // TODO: Also print attributes of the layer_data!
     }
 
@@ -200,7 +323,7 @@ namespace kra
         fprintf(stdout, "   >> children:\n");
         for (const auto &layer : children)
         {
-            fprintf(stdout, "      - '%s' (%s)\n", layer->name.c_str(), layer->uuid.c_str());
+            fprintf(stdout, "      - '%.*s' (%.*s)\n", (int)layer->name.size(), layer->name.data(), (int)layer->uuid.size(), layer->uuid.data());
         }
     }
 };
\ No newline at end of file
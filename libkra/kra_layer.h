@@ -9,12 +9,16 @@
 
 #include "kra_utility.h"
 
+#include "kra_archive.h"
 #include "kra_layer_data.h"
+#include "kra_string_arena.h"
 #include "kra_exported_layer.h"
 
 #include "../tinyxml2/tinyxml2.h"
 #include "../zlib/contrib/minizip/unzip.h"
 
+#include <mutex>
+
 namespace kra
 {
     /* This class stores the attributes (as found in 'maindoc.xml') for a single layer */
@@ -22,16 +26,28 @@ namespace kra
     class Layer
     {
     private:
-        void _import_paint_attributes(const std::string &p_name, unzFile &p_file, const tinyxml2::XMLElement *p_xml_element);
-        void _import_group_attributes(const std::string &p_name, unzFile &p_file, const tinyxml2::XMLElement *p_xml_element);
+        /* Only set when the document is loaded lazily, in which case the tile data is extracted on first use */
+        std::shared_ptr<Archive> _archive;
+        std::string_view _document_name;
+        mutable std::once_flag _layer_data_flag;
+
+        int _import_layer_data(const std::string &p_name, Archive &p_archive) const;
+        void _import_layer_data(EntryData &&p_layer_content, const EntryData &p_default_pixel) const;
+        std::string _get_layer_path(const std::string &p_name) const;
+        std::unique_ptr<ExportedLayer> _get_exported_properties() const;
+
+        void _import_paint_attributes(const tinyxml2::XMLElement *p_xml_element);
 
         void _print_paint_layer_attributes() const;
         void _print_group_layer_attributes() const;
 
     public:
-        std::string filename;
-        std::string name;
-        std::string uuid;
+        /* These point into the strings of the Document, which are interned while parsing 'maindoc.xml' */
+        std::string_view filename;
+        std::string_view name;
+        std::string_view uuid;
+        /* Only known once the document has built its layer table, which happens at the very end of loading */
+        LayerHandle handle = INVALID_LAYER_HANDLE;
 
         unsigned int x;
         unsigned int y;
@@ -44,14 +60,26 @@ namespace kra
 
         // PAINT_LAYER
         ColorSpace color_space = RGBA;
-        std::unique_ptr<LayerData> layer_data;
+        /* Sizes of this layer's entry as stored in the archive's central directory, known without extracting the entry */
+        uint64_t compressed_size = 0;
+        uint64_t uncompressed_size = 0;
+        /* NOTE: This stays empty until get_layer_data() is called when the document is loaded lazily! */
+        mutable std::unique_ptr<LayerData> layer_data;
 
         // GROUP_LAYER
         std::vector<std::unique_ptr<Layer>> children;
 
-        void import_attributes(const std::string &p_name, unzFile &p_file, const tinyxml2::XMLElement *p_xml_element);
+        void import_attributes(const tinyxml2::XMLElement *p_xml_element, StringArena &p_strings);
+        int import_layer_data(const std::string &p_name, Archive &p_archive);
+        int extract_layer_entry(const std::string &p_name, Archive &p_archive, EntryData &p_result, EntryData &p_default_pixel) const;
+        void import_layer_data(EntryData &&p_layer_content, const EntryData &p_default_pixel);
+        void defer_layer_data(std::string_view p_name, std::shared_ptr<Archive> p_archive);
+        void import_entry_sizes(const std::string &p_name, const Archive &p_archive);
+
+        const LayerData *get_layer_data() const;
 
         std::unique_ptr<ExportedLayer> get_exported_layer() const;
+        std::unique_ptr<ExportedLayer> get_exported_region(int32_t p_x, int32_t p_y, unsigned int p_width, unsigned int p_height) const;
 
         void print_layer_attributes() const;
     };
@@ -6,23 +6,227 @@
 
 #include "kra_layer_data.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <functional>
+#include <thread>
+
+/* The LZF decoder & the channel interleaving work on 16 bytes at a time, using SSE2 or NEON if the target supports it */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KRA_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define KRA_USE_NEON
+#endif
+
 namespace kra
 {
     // ---------------------------------------------------------------------------------------------------------------------
-    // Extract the layer's attributes and data from the file's raw binary content.
+    // Parse a decimal number that fits in an int32_t, returns false if there are no digits or if the number overflows
+    // ---------------------------------------------------------------------------------------------------------------------
+    static bool _parse_int32(const uint8_t *&p_cursor, const uint8_t *p_end, bool p_allow_negative, int32_t &p_value)
+    {
+        bool is_negative = false;
+        if (p_allow_negative && p_cursor < p_end && *p_cursor == '-')
+        {
+            is_negative = true;
+            p_cursor++;
+        }
+
+        const uint8_t *digits = p_cursor;
+        int64_t value = 0;
+        while (p_cursor < p_end && *p_cursor >= '0' && *p_cursor <= '9')
+        {
+            value = value * 10 + (*p_cursor - '0');
+            if (value > (int64_t)INT32_MAX + 1)
+            {
+                return false;
+            }
+            p_cursor++;
+        }
+        if (p_cursor == digits)
+        {
+            return false;
+        }
+
+        value = is_negative ? -value : value;
+        if (value > INT32_MAX)
+        {
+            return false;
+        }
+        p_value = (int32_t)value;
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Skip a single expected character, returns false if any other character (or nothing at all) is found instead
+    // ---------------------------------------------------------------------------------------------------------------------
+    static bool _skip_character(const uint8_t *&p_cursor, const uint8_t *p_end, uint8_t p_character)
+    {
+        if (p_cursor < p_end && *p_cursor == p_character)
+        {
+            p_cursor++;
+            return true;
+        }
+        return false;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Hash a block of bytes using four independent lanes of 8 bytes each (similar to xxHash64), equal hashes still have to
+    // be confirmed by comparing the bytes themselves
     // ---------------------------------------------------------------------------------------------------------------------
-    void LayerData::import_attributes(const std::vector<unsigned char> &p_layer_content)
+    static uint64_t _hash_bytes(const uint8_t *p_data, size_t p_size)
     {
+        const uint64_t first_prime = 0x9E3779B185EBCA87ull;
+        const uint64_t second_prime = 0xC2B2AE3D27D4EB4Full;
+        auto rotate = [](uint64_t p_value, int p_bits)
+        { return (p_value << p_bits) | (p_value >> (64 - p_bits)); };
+
+        uint64_t lanes[4] = {first_prime + second_prime, second_prime, 0, 0 - first_prime};
+        size_t i = 0;
+        for (; i + 32 <= p_size; i += 32)
+        {
+            for (size_t lane = 0; lane < 4; lane++)
+            {
+                uint64_t value;
+                std::memcpy(&value, p_data + i + lane * 8, 8);
+                lanes[lane] = rotate(lanes[lane] + value * second_prime, 31) * first_prime;
+            }
+        }
+
+        uint64_t hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18) + p_size;
+        for (; i < p_size; i++)
+        {
+            hash = rotate(hash ^ (p_data[i] * first_prime), 11) * second_prime;
+        }
+
+        hash ^= hash >> 33;
+        hash *= second_prime;
+        return hash ^ (hash >> 29);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Copy exactly 16 bytes, which can be unaligned but shouldn't overlap
+    // ---------------------------------------------------------------------------------------------------------------------
+    static inline void _copy_16_bytes(uint8_t *p_destination, const uint8_t *p_source)
+    {
+#if defined(KRA_USE_SSE2)
+        _mm_storeu_si128((__m128i *)p_destination, _mm_loadu_si128((const __m128i *)p_source));
+#elif defined(KRA_USE_NEON)
+        vst1q_u8(p_destination, vld1q_u8(p_source));
+#else
+        std::memcpy(p_destination, p_source, 16);
+#endif
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Store the same 16 bytes every p_step bytes until at least p_length bytes are written, p_step is never larger than 16
+    // ---------------------------------------------------------------------------------------------------------------------
+    static inline void _repeat_16_bytes(uint8_t *p_destination, const uint8_t *p_pattern, size_t p_length, size_t p_step)
+    {
+#if defined(KRA_USE_SSE2)
+        const __m128i pattern = _mm_loadu_si128((const __m128i *)p_pattern);
+        for (size_t i = 0; i < p_length; i += p_step)
+        {
+            _mm_storeu_si128((__m128i *)(p_destination + i), pattern);
+        }
+#elif defined(KRA_USE_NEON)
+        const uint8x16_t pattern = vld1q_u8(p_pattern);
+        for (size_t i = 0; i < p_length; i += p_step)
+        {
+            vst1q_u8(p_destination + i, pattern);
+        }
+#else
+        for (size_t i = 0; i < p_length; i += p_step)
+        {
+            std::memcpy(p_destination + i, p_pattern, 16);
+        }
+#endif
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Interleave 16 bytes of four separate channels into 16 pixels (= 64 bytes) of four channels each
+    // ---------------------------------------------------------------------------------------------------------------------
+    static inline void _interleave_16_pixels(uint8_t *p_destination, const uint8_t *p_first, const uint8_t *p_second, const uint8_t *p_third, const uint8_t *p_fourth)
+    {
+#if defined(KRA_USE_SSE2)
+        const __m128i first = _mm_loadu_si128((const __m128i *)p_first);
+        const __m128i second = _mm_loadu_si128((const __m128i *)p_second);
+        const __m128i third = _mm_loadu_si128((const __m128i *)p_third);
+        const __m128i fourth = _mm_loadu_si128((const __m128i *)p_fourth);
+        const __m128i low_pairs = _mm_unpacklo_epi8(first, second);
+        const __m128i high_pairs = _mm_unpackhi_epi8(first, second);
+        const __m128i low_other_pairs = _mm_unpacklo_epi8(third, fourth);
+        const __m128i high_other_pairs = _mm_unpackhi_epi8(third, fourth);
+        _mm_storeu_si128((__m128i *)p_destination, _mm_unpacklo_epi16(low_pairs, low_other_pairs));
+        _mm_storeu_si128((__m128i *)(p_destination + 16), _mm_unpackhi_epi16(low_pairs, low_other_pairs));
+        _mm_storeu_si128((__m128i *)(p_destination + 32), _mm_unpacklo_epi16(high_pairs, high_other_pairs));
+        _mm_storeu_si128((__m128i *)(p_destination + 48), _mm_unpackhi_epi16(high_pairs, high_other_pairs));
+#elif defined(KRA_USE_NEON)
+        uint8x16x4_t pixels;
+        pixels.val[0] = vld1q_u8(p_first);
+        pixels.val[1] = vld1q_u8(p_second);
+        pixels.val[2] = vld1q_u8(p_third);
+        pixels.val[3] = vld1q_u8(p_fourth);
+        vst4q_u8(p_destination, pixels);
+#else
+        for (size_t i = 0; i < 16; i++)
+        {
+            p_destination[i * 4] = p_first[i];
+            p_destination[i * 4 + 1] = p_second[i];
+            p_destination[i * 4 + 2] = p_third[i];
+            p_destination[i * 4 + 3] = p_fourth[i];
+        }
+#endif
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract the layer's attributes and data from a copy of the file's raw binary content.
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::import_attributes(const uint8_t *p_layer_content, size_t p_size)
+    {
+        /* The tiles can only point into memory that is kept alive by this LayerData, so the content is copied exactly once */
+        EntryData layer_content;
+        layer_content.buffer.reset(new unsigned char[p_size]);
+        std::memcpy(layer_content.buffer.get(), p_layer_content, p_size);
+        layer_content.data = layer_content.buffer.get();
+        layer_content.size = p_size;
+
+        import_attributes(std::move(layer_content));
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract the layer's attributes and data from the file's raw binary content, which is retained by this LayerData.
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::import_attributes(EntryData &&p_layer_content)
+    {
+        _layer_content = std::move(p_layer_content);
+        const uint8_t *layer_content = _layer_content.data;
+        const size_t size = _layer_content.size;
+
         /* This code works with a global pointer index that gets incremented depending on element size */
         /* current_index obviously starts at zero and will be passed by reference */
-        unsigned int current_index = 0;
+        size_t current_index = 0;
 
         /* Extract the main header from the tiles */
-        version = _get_element_value(p_layer_content, "VERSION ", current_index);
-        tile_width = _get_element_value(p_layer_content, "TILEWIDTH ", current_index);
-        tile_height = _get_element_value(p_layer_content, "TILEHEIGHT ", current_index);
-        pixel_size = _get_element_value(p_layer_content, "PIXELSIZE ", current_index);
-        unsigned int decompressed_length = pixel_size * tile_width * tile_height;
+        version = _get_element_value(layer_content, size, "VERSION ", current_index);
+        tile_width = _get_element_value(layer_content, size, "TILEWIDTH ", current_index);
+        tile_height = _get_element_value(layer_content, size, "TILEHEIGHT ", current_index);
+        pixel_size = _get_element_value(layer_content, size, "PIXELSIZE ", current_index);
+
+        /* Empty tiles or pixels can't be laid out in a grid, nor is there anything to decompress into them */
+        if (tile_width == 0 || tile_height == 0 || pixel_size == 0)
+        {
+            throw std::out_of_range("Tile or pixel size in layer content is zero");
+        }
+        /* A single decompressed tile always has to fit in an int, as that's what the LZF decoder works with */
+        if (tile_width > MAX_TILE_SIZE || tile_height > MAX_TILE_SIZE || pixel_size > MAX_PIXEL_SIZE)
+        {
+            throw std::out_of_range("Tile or pixel size in layer content is too large");
+        }
 
         if (verbosity_level >= VERBOSE)
         {
@@ -30,129 +234,387 @@ namespace kra
             // print_layer_data_attributes();
         }
 
-        unsigned int number_of_tiles = _get_element_value(p_layer_content, "DATA ", current_index);
+        unsigned int number_of_tiles = _get_element_value(layer_content, size, "DATA ", current_index);
+
+        /* The number of tiles can't be trusted blindly, but every tile needs at least a header like "0,0,,0\n" */
+        const size_t expected_number_of_tiles = std::min((size_t)number_of_tiles, (size - current_index) / 7);
+        _tile_lefts.clear();
+        _tile_tops.clear();
+        _tile_offsets.clear();
+        _tile_lengths.clear();
+        _tile_lefts.reserve(expected_number_of_tiles);
+        _tile_tops.reserve(expected_number_of_tiles);
+        _tile_offsets.reserve(expected_number_of_tiles);
+        _tile_lengths.reserve(expected_number_of_tiles);
 
+        size_t misaligned_tiles = 0;
         for (unsigned int i = 0; i < number_of_tiles; i++)
         {
-            std::unique_ptr<Tile> tile = std::make_unique<Tile>();
-
-            /* Now it is time to extract & decompress the data */
             /* First the non-general element of the header needs to be extracted */
-            std::string headerString = _get_header_line(p_layer_content, current_index);
-            std::regex e("(-?\\d*),(-?\\d*),(\\w*),(\\d*)");
-            std::smatch sm;
-            std::regex_match(headerString, sm, e);
-
-            /* This header contains: */
-            /* 1. A number that defines the left position of the tile (CAN BE NEGATIVE!!!) */
-            /* 2. A number that defines the top position of the tile (CAN BE NEGATIVE!!!) */
-            /* 3. The string "LZF" which states the compression algorithm */
-            /* 4. A number that defines the number of bytes of the data that comes after this header. */
-
-            /* sm[0] is the full string match which we don't need */
-            /* The left position of the tile */
-            std::ssub_match base_sub_match = sm[1];
-            tile->left = std::stoi(base_sub_match.str());
-            /* The top position of the tile */
-            base_sub_match = sm[2];
-            tile->top = std::stoi(base_sub_match.str());
-            /* NOTE: We don't really care about sm[3] since it is always 'LZF' */
-            /* The number of compressed bytes coming after this header */
-            base_sub_match = sm[4];
-            tile->compressed_length = std::stoi(base_sub_match.str());
-
-            /* Put all the data in a vector */
-            std::vector<uint8_t> compressed_data(p_layer_content.begin() + current_index, p_layer_content.begin() + current_index + tile->compressed_length);
-            tile->compressed_data = compressed_data;
+            int32_t tile_left;
+            int32_t tile_top;
+            int32_t compressed_length;
+            _parse_tile_header(layer_content, size, current_index, tile_left, tile_top, compressed_length);
+
+            if ((size_t)compressed_length > size - current_index)
+            {
+                throw std::out_of_range("Tile data in layer content is truncated");
+            }
+
+            /* Krita always places tiles on multiples of the tile size, a tile in between grid cells can't be composed */
+            if ((int64_t)tile_left % tile_width != 0 || (int64_t)tile_top % tile_height != 0)
+            {
+                misaligned_tiles++;
+                current_index += compressed_length;
+                continue;
+            }
+
+            /* The data itself is never copied, only its position is remembered */
+            _tile_lefts.push_back(tile_left);
+            _tile_tops.push_back(tile_top);
+            _tile_offsets.push_back(current_index);
+            _tile_lengths.push_back((uint32_t)compressed_length);
 
             /* Add the compressed_length to the current_index so the next tile starts at the correct position */
-            // Needs to be done BEFORE moving the pointer's ownership to the vector!
-            current_index += tile->compressed_length;
+            current_index += compressed_length;
+        }
 
-            tiles.push_back(std::move(tile));
+        if (misaligned_tiles > 0 && verbosity_level > QUIET)
+        {
+            fprintf(stdout, "WARNING: %zu tile(s) are not aligned to the %ux%u tile grid of the layer, they are ignored.\n", misaligned_tiles, tile_width, tile_height);
         }
 
         _update_dimensions();
+        _build_tile_grid();
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Decompress & compose the binary data of the entire layer
+    // Import the value of every pixel that isn't covered by a tile, as stored in the layer's '.defaultpixel'-entry.
+    // NOTE: This can only be done after importing the attributes, as the pixel has to match the layer's pixel size!
     // ---------------------------------------------------------------------------------------------------------------------
-    std::vector<uint8_t> LayerData::get_composed_data(ColorSpace color_space) const
+    void LayerData::import_default_pixel(const uint8_t *p_data, size_t p_size)
+    {
+        _default_pixel.clear();
+        if (p_size != pixel_size)
+        {
+            if (verbosity_level > QUIET)
+            {
+                fprintf(stdout, "WARNING: Default pixel has a size of %zu bytes instead of %u bytes, it is ignored.\n", p_size, pixel_size);
+            }
+            return;
+        }
+
+        /* A transparent default pixel is what an empty (= zero-initialized) buffer already contains */
+        if (std::any_of(p_data, p_data + p_size, [](uint8_t p_value)
+                        { return p_value != 0; }))
+        {
+            _default_pixel.assign(p_data, p_data + p_size);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decompress & compose the binary data of the entire layer, the rows of the tile grid are divided over multiple
+    // threads (= p_thread_count, or get_thread_count() if zero) as tiles never overlap
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::vector<uint8_t> LayerData::get_composed_data(ColorSpace color_space, unsigned int p_thread_count) const
     {
         /* Allocate space for the output data! */
-        const unsigned int decompressed_length = pixel_size * tile_width * tile_height;
-        const unsigned int number_of_columns = get_width() / tile_width;
-        const unsigned int number_of_rows = get_height() / tile_height;
-        const unsigned int row_length = number_of_columns * pixel_size * tile_width;
+        const size_t decompressed_length = (size_t)pixel_size * tile_width * tile_height;
+        const size_t row_length = (size_t)_grid_columns * pixel_size * tile_width;
 
-        const size_t composed_length = number_of_columns * number_of_rows * decompressed_length;
+        const size_t composed_length = (size_t)_grid_columns * _grid_rows * decompressed_length;
         std::vector<uint8_t> composed_data(composed_length);
 
-        /* Go through all the tiles and decompress their data */
-        for (auto const &tile : tiles)
+        const std::vector<unsigned int> channel_order = _get_channel_order(color_space);
+        const std::vector<uint8_t> default_pixel = get_default_pixel(color_space);
+        _analyze_tiles();
+
+        /* The pixels of the uniform tiles are put in the same channel order as the composed data once, instead of for every tile */
+        std::vector<uint8_t> uniform_pixels(_uniform_pixels.size());
+        for (size_t i = 0; i < uniform_pixels.size(); i += pixel_size)
         {
-            std::vector<uint8_t> unsorted_data(decompressed_length);
-            /* Now... the first byte of the data is actually some sort of indicator of compression */
-            /* As follows: */
-            /* 0 -> No compression, the data is actually raw! */
-            /* 1 -> The data was compressed using LZF */
-            // NOTE: At the time of writing this byte cannot be changed from its default value (1) and thus the data will ALWAYS be compressed.
-            _lzff_decompress(tile->compressed_data.data() + 1, tile->compressed_length, unsorted_data.data(), decompressed_length);
+            for (unsigned int j = 0; j < pixel_size; j++)
+            {
+                uniform_pixels[i + j] = _uniform_pixels[i + channel_order[j]];
+            }
+        }
+
+        /* The grid already knows which tile ends up in every cell, so no two workers ever write to the same cell */
+        std::atomic<unsigned int> next_row(0);
+        auto get_cell_data = [&](uint32_t p_tile_index)
+        {
+            const size_t column = (size_t)(((int64_t)_tile_lefts[p_tile_index] - left) / tile_width);
+            const size_t row = (size_t)(((int64_t)_tile_tops[p_tile_index] - top) / tile_height);
+            return composed_data.data() + row * tile_height * row_length + column * tile_width * pixel_size;
+        };
 
-            // TODO: Conversion between color profiles could potentially be done here?
+        /* First every unique tile is decoded... */
+        auto decode_work = [&]()
+        {
+            /* Small enough to stay in the L1 cache, every tile is decompressed into it & then interleaved straight into its final place */
+            std::vector<uint8_t> unsorted_data(decompressed_length + LZF_OUTPUT_PADDING);
 
-            /* Due to historical reasons the red and blue pixel values are swapped in the case of RGBA & RGBA16 */
-            /* This is to be rectified by using a special vector with swapped values */
-            std::vector<unsigned int> pixel_vector(pixel_size);
-            std::iota(std::begin(pixel_vector), std::end(pixel_vector), 0);
-            if (color_space == ColorSpace::RGBA)
+            unsigned int row;
+            while ((row = next_row++) < _grid_rows)
             {
-                unsigned int bytes_per_channel = 1;
-                std::swap_ranges(pixel_vector.begin(), pixel_vector.begin() + bytes_per_channel, pixel_vector.begin() + 2 * bytes_per_channel);
+                for (unsigned int column = 0; column < _grid_columns; column++)
+                {
+                    uint8_t *destination = composed_data.data() + (size_t)row * tile_height * row_length + (size_t)column * tile_width * pixel_size;
+                    const uint32_t tile_index = _tile_grid[(size_t)row * _grid_columns + column];
+                    if (tile_index != INVALID_TILE_INDEX)
+                    {
+                        const uint32_t uniform_index = _uniform_pixel_indices[tile_index];
+                        if (uniform_index != INVALID_TILE_INDEX)
+                        {
+                            /* Uniform tiles are never decoded at all, transparent ones don't even have to be filled */
+                            const uint8_t *pixel = uniform_pixels.data() + (size_t)uniform_index * pixel_size;
+                            if (std::any_of(pixel, pixel + pixel_size, [](uint8_t p_value)
+                                            { return p_value != 0; }))
+                            {
+                                for (unsigned int row_index = 0; row_index < tile_height; row_index++)
+                                {
+                                    _fill_pixels(destination + row_index * row_length, tile_width, pixel);
+                                }
+                            }
+                        }
+                        else if (_tile_sources[tile_index] == tile_index)
+                        {
+                            _decode_tile(tile_index, channel_order, unsorted_data, destination, row_length);
+                        }
+                    }
+                    else if (!_default_pixel.empty())
+                    {
+                        /* Cells without a tile are already transparent, unless the layer has a different default pixel */
+                        for (unsigned int row_index = 0; row_index < tile_height; row_index++)
+                        {
+                            _fill_pixels(destination + row_index * row_length, tile_width, default_pixel.data());
+                        }
+                    }
+                }
+            }
+        };
+
+        /* ...after which the (non-uniform) duplicates are copied from the already composed tile they refer to */
+        auto copy_work = [&]()
+        {
+            unsigned int row;
+            while ((row = next_row++) < _grid_rows)
+            {
+                for (unsigned int column = 0; column < _grid_columns; column++)
+                {
+                    const uint32_t tile_index = _tile_grid[(size_t)row * _grid_columns + column];
+                    if (tile_index == INVALID_TILE_INDEX || _tile_sources[tile_index] == tile_index || _uniform_pixel_indices[tile_index] != INVALID_TILE_INDEX)
+                    {
+                        continue;
+                    }
+
+                    uint8_t *destination = composed_data.data() + (size_t)row * tile_height * row_length + (size_t)column * tile_width * pixel_size;
+                    const uint8_t *source = get_cell_data(_tile_sources[tile_index]);
+                    for (unsigned int row_index = 0; row_index < tile_height; row_index++)
+                    {
+                        std::memcpy(destination + row_index * row_length, source + row_index * row_length, (size_t)tile_width * pixel_size);
+                    }
+                }
             }
-            else if (color_space == ColorSpace::RGBA16)
+        };
+
+        /* Starting a thread isn't free, so small layers use fewer threads (or none at all) */
+        const unsigned int thread_count = (p_thread_count > 0) ? p_thread_count : get_thread_count();
+        const size_t worker_count = std::max(std::min({(size_t)thread_count, (size_t)_grid_rows, _unique_tile_count / MIN_TILES_PER_THREAD}), (size_t)1);
+        auto run_workers = [&](const std::function<void()> &p_work)
+        {
+            next_row = 0;
+            std::vector<std::exception_ptr> exceptions(worker_count);
+            auto work = [&](size_t p_worker_index)
             {
-                unsigned int bytes_per_channel = 2;
-                std::swap_ranges(pixel_vector.begin(), pixel_vector.begin() + bytes_per_channel, pixel_vector.begin() + 2 * bytes_per_channel);
+                try
+                {
+                    p_work();
+                }
+                catch (...)
+                {
+                    exceptions[p_worker_index] = std::current_exception();
+                    /* Make sure that the other workers stop as soon as possible */
+                    next_row = _grid_rows;
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < worker_count; i++)
+            {
+                threads.emplace_back(work, i);
             }
+            work(0);
 
-            /* Data is saved in following format: */
-            /* (R0 R1 R2...) (G0 G1 G2...) (B0 B1 B2...) (A0 A1 A2...)*/
-            /* which is different from the wanted format: */
-            /* (R0 G0 B0 A0) (R1 G1 B1 A1) (R2 G2 B2 A2)...*/
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
 
-            /* We'll have to do some sorting as a result!*/
-            std::vector<uint8_t> sorted_data(decompressed_length);
-            int tile_area = tile_height * tile_width;
-            for (int i = 0; i < tile_area; i++)
+            /* Exceptions are re-thrown on the calling thread, identical to a single-threaded composition */
+            for (auto const &exception : exceptions)
             {
-                unsigned int real_index = 0;
-                for (unsigned int j : pixel_vector)
+                if (exception)
                 {
-                    sorted_data[i * pixel_size + real_index] = unsorted_data[j * tile_area + i];
-                    real_index++;
+                    std::rethrow_exception(exception);
                 }
             }
+        };
+
+        run_workers(decode_work);
+        if (_unique_tile_count < _tile_offsets.size())
+        {
+            run_workers(copy_work);
+        }
+
+        return composed_data;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decompress & compose only the tiles that overlap the given rectangle, which is expressed in the same coordinates as
+    // the layer's extents (see get_left() & get_top()). Pixels that aren't covered by any tile get the default pixel.
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::vector<uint8_t> LayerData::get_composed_region(int32_t p_x, int32_t p_y, unsigned int p_width, unsigned int p_height, ColorSpace color_space) const
+    {
+        std::vector<uint8_t> composed_data((size_t)p_width * p_height * pixel_size);
+        if (!_default_pixel.empty())
+        {
+            _fill_pixels(composed_data.data(), (size_t)p_width * p_height, get_default_pixel(color_space).data());
+        }
+
+        /* Only the part of the rectangle that lies within the layer's extents can contain any tiles */
+        const int64_t region_left = std::max((int64_t)p_x, (int64_t)left);
+        const int64_t region_top = std::max((int64_t)p_y, (int64_t)top);
+        const int64_t region_right = std::min((int64_t)p_x + p_width, (int64_t)right);
+        const int64_t region_bottom = std::min((int64_t)p_y + p_height, (int64_t)bottom);
+        if (region_left >= region_right || region_top >= region_bottom)
+        {
+            return composed_data;
+        }
 
-            /* Now we have to construct the data in such a way that all tiles are in the correct positions */
-            const int relative_tile_top = tile->top - top;
-            const int relative_tile_left = tile->left - left;
-            const size_t size = pixel_size * tile_width;
-            for (int row_index = 0; row_index < (int)tile_height; row_index++)
+        const size_t decompressed_length = (size_t)pixel_size * tile_width * tile_height;
+        const std::vector<unsigned int> channel_order = _get_channel_order(color_space);
+        std::vector<uint8_t> unsorted_data(decompressed_length + LZF_OUTPUT_PADDING);
+        std::vector<uint8_t> sorted_data(decompressed_length);
+        std::vector<uint8_t> uniform_pixel(pixel_size);
+        std::vector<uint8_t> sorted_pixel(pixel_size);
+
+        /* The grid tells exactly which tiles overlap the rectangle, all other tiles are never even looked at */
+        const unsigned int first_column = (unsigned int)((region_left - left) / tile_width);
+        const unsigned int last_column = (unsigned int)((region_right - 1 - left) / tile_width);
+        const unsigned int first_row = (unsigned int)((region_top - top) / tile_height);
+        const unsigned int last_row = (unsigned int)((region_bottom - 1 - top) / tile_height);
+        for (unsigned int row = first_row; row <= last_row; row++)
+        {
+            for (unsigned int column = first_column; column <= last_column; column++)
             {
-                uint8_t *destination = composed_data.data() + row_index * row_length;
-                destination += relative_tile_left * pixel_size;
-                destination += relative_tile_top * row_length;
-                uint8_t *source = sorted_data.data() + size * row_index;
-                /* Copy the row of the tile to the composed data */
-                std::memcpy(destination, source, size);
+                const uint32_t tile_index = _tile_grid[(size_t)row * _grid_columns + column];
+                if (tile_index == INVALID_TILE_INDEX)
+                {
+                    continue;
+                }
+
+                /* Only the part of the tile that overlaps the rectangle ends up in the result */
+                const int64_t tile_left = (int64_t)left + (int64_t)column * tile_width;
+                const int64_t tile_top = (int64_t)top + (int64_t)row * tile_height;
+                const int64_t copy_left = std::max(tile_left, region_left);
+                const int64_t copy_right = std::min(tile_left + tile_width, region_right);
+                const int64_t copy_top = std::max(tile_top, region_top);
+                const int64_t copy_bottom = std::min(tile_top + tile_height, region_bottom);
+
+                /* Uniform tiles are recognized from their compressed data alone, after which that part is simply filled */
+                if (_get_uniform_pixel(tile_index, uniform_pixel.data()))
+                {
+                    for (unsigned int i = 0; i < pixel_size; i++)
+                    {
+                        sorted_pixel[i] = uniform_pixel[channel_order[i]];
+                    }
+                    for (int64_t y = copy_top; y < copy_bottom; y++)
+                    {
+                        uint8_t *destination = composed_data.data() + ((size_t)(y - p_y) * p_width + (size_t)(copy_left - p_x)) * pixel_size;
+                        _fill_pixels(destination, (size_t)(copy_right - copy_left), sorted_pixel.data());
+                    }
+                    continue;
+                }
+
+                /* Tiles that lie completely within the rectangle are written straight into their final place */
+                if (tile_left >= p_x && tile_left + tile_width <= (int64_t)p_x + p_width && tile_top >= p_y && tile_top + tile_height <= (int64_t)p_y + p_height)
+                {
+                    uint8_t *destination = composed_data.data() + ((size_t)(tile_top - p_y) * p_width + (size_t)(tile_left - p_x)) * pixel_size;
+                    _decode_tile(tile_index, channel_order, unsorted_data, destination, (size_t)p_width * pixel_size);
+                    continue;
+                }
+
+                _decode_tile(tile_index, channel_order, unsorted_data, sorted_data.data(), (size_t)tile_width * pixel_size);
+
+                const size_t size = (size_t)(copy_right - copy_left) * pixel_size;
+                for (int64_t y = copy_top; y < copy_bottom; y++)
+                {
+                    uint8_t *destination = composed_data.data() + ((size_t)(y - p_y) * p_width + (size_t)(copy_left - p_x)) * pixel_size;
+                    const uint8_t *source = sorted_data.data() + ((size_t)(y - tile_top) * tile_width + (size_t)(copy_left - tile_left)) * pixel_size;
+                    std::memcpy(destination, source, size);
+                }
             }
         }
 
         return composed_data;
     }
 
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find the tile that covers the given position (in the same coordinates as the layer's extents) by looking it up in
+    // the tile grid, returns INVALID_TILE_INDEX if no tile covers it
+    // ---------------------------------------------------------------------------------------------------------------------
+    uint32_t LayerData::find_tile(int32_t p_x, int32_t p_y) const
+    {
+        if (p_x < left || p_x >= right || p_y < top || p_y >= bottom)
+        {
+            return INVALID_TILE_INDEX;
+        }
+
+        const unsigned int column = (unsigned int)(((int64_t)p_x - left) / tile_width);
+        const unsigned int row = (unsigned int)(((int64_t)p_y - top) / tile_height);
+        return _tile_grid[(size_t)row * _grid_columns + column];
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the value of every pixel that isn't covered by any tile, with its channels in the same order as the composed data
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::vector<uint8_t> LayerData::get_default_pixel(ColorSpace color_space) const
+    {
+        std::vector<uint8_t> default_pixel(pixel_size);
+        if (!_default_pixel.empty())
+        {
+            const std::vector<unsigned int> channel_order = _get_channel_order(color_space);
+            for (unsigned int i = 0; i < pixel_size; i++)
+            {
+                default_pixel[i] = _default_pixel[channel_order[i]];
+            }
+        }
+
+        return default_pixel;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Helper functions for accessing the number of tiles, tiles that are hidden by a later tile aren't counted as unique
+    // (or uniform)
+    // ---------------------------------------------------------------------------------------------------------------------
+    size_t LayerData::get_tile_count() const
+    {
+        return _tile_offsets.size();
+    }
+
+    size_t LayerData::get_unique_tile_count() const
+    {
+        _analyze_tiles();
+        return _unique_tile_count;
+    }
+
+    size_t LayerData::get_uniform_tile_count() const
+    {
+        _analyze_tiles();
+        return _uniform_tile_count;
+    }
+
     // ---------------------------------------------------------------------------------------------------------------------
     // Helper functions for accessing this layer's dimensions
     // ---------------------------------------------------------------------------------------------------------------------
@@ -201,85 +663,490 @@ namespace kra
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Extract a header line and match it with the element name
+    // Parse a header line of the form "<element name><value>\n" straight from the raw content, e.g. "TILEWIDTH 64\n"
     // ---------------------------------------------------------------------------------------------------------------------
-    unsigned int LayerData::_get_element_value(const std::vector<unsigned char> &p_layer_content, const std::string &p_element_name, unsigned int &p_index) const
+    unsigned int LayerData::_get_element_value(const uint8_t *p_layer_content, size_t p_size, const std::string &p_element_name, size_t &p_index) const
     {
-        unsigned int element_int_value = -1;
-        /* First extract the header element */
-        std::string element_value = _get_header_line(p_layer_content, p_index);
-        /* Try to match the elementValue string */
-        if (element_value.find(p_element_name) != std::string::npos)
+        const uint8_t *cursor = p_layer_content + p_index;
+        const uint8_t *end = p_layer_content + p_size;
+
+        /* The value is used as a size or count, so a missing or garbled header can't simply fall back to some default */
+        bool is_valid = (size_t)(end - cursor) >= p_element_name.length() && std::memcmp(cursor, p_element_name.data(), p_element_name.length()) == 0;
+        int32_t element_value = 0;
+        if (is_valid)
         {
-            size_t pos = element_value.find(p_element_name);
-            /* If found then erase it from string */
-            element_value.erase(pos, p_element_name.length());
-            /* Dump it into the output variable using stoi */
-            element_int_value = std::stoi(element_value);
+            cursor += p_element_name.length();
+            is_valid = _parse_int32(cursor, end, false, element_value) && _skip_character(cursor, end, 0x0A);
         }
-        else
+
+        if (!is_valid)
         {
-            fprintf(stdout, "WARNING: Missing header element in tile with name '%s'\n", p_element_name.c_str());
+            throw std::invalid_argument("Header element '" + p_element_name + "' in layer content is missing or malformed");
         }
-        return element_int_value;
+
+        p_index = cursor - p_layer_content;
+        return (unsigned int)element_value;
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Extract a header line starting from the current_index until the next "0x0A"
+    // Parse the header line of a single tile straight from the raw content, without copying it anywhere
     // ---------------------------------------------------------------------------------------------------------------------
-    std::string LayerData::_get_header_line(const std::vector<unsigned char> &p_layer_content, unsigned int &p_index) const
+    void LayerData::_parse_tile_header(const uint8_t *p_layer_content, size_t p_size, size_t &p_index, int32_t &p_left, int32_t &p_top, int32_t &p_length) const
     {
-        unsigned int begin_index = p_index;
-        /* Just go through the vector until you encounter "0x0A" (= the hex value of Line Feed) */
-        while (p_layer_content.at(p_index) != (char)0x0A)
+        /* This header contains: */
+        /* 1. A number that defines the left position of the tile (CAN BE NEGATIVE!!!) */
+        /* 2. A number that defines the top position of the tile (CAN BE NEGATIVE!!!) */
+        /* 3. The string "LZF" which states the compression algorithm */
+        /* 4. A number that defines the number of bytes of the data that comes after this header. */
+        /* These are separated by commas and the header is terminated by "0x0A", e.g. "-64,128,LZF,1234\n" */
+        const uint8_t *cursor = p_layer_content + p_index;
+        const uint8_t *end = p_layer_content + p_size;
+
+        bool is_valid = _parse_int32(cursor, end, true, p_left) && _skip_character(cursor, end, ',');
+        is_valid = is_valid && _parse_int32(cursor, end, true, p_top) && _skip_character(cursor, end, ',');
+        if (is_valid)
         {
-            p_index++;
+            /* NOTE: We don't really care about the compression since it is always 'LZF' */
+            while (cursor < end && (std::isalnum(*cursor) || *cursor == '_'))
+            {
+                cursor++;
+            }
+            is_valid = _skip_character(cursor, end, ',');
         }
-        unsigned int end_index = p_index;
-        /* Extract this header element */
-        std::string element_value(p_layer_content.begin() + begin_index, p_layer_content.begin() + end_index);
-        /* Increment the current_index pointer so that we skip the "0x0A" character */
-        p_index++;
+        is_valid = is_valid && _parse_int32(cursor, end, false, p_length) && _skip_character(cursor, end, 0x0A);
 
-        return element_value;
+        if (!is_valid)
+        {
+            throw std::invalid_argument("Tile header in layer content is malformed");
+        }
+
+        p_index = cursor - p_layer_content;
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Go through all the tiles and find the layer's extents
+    // Get the order in which the channels of a pixel have to be interleaved for the given color space
     // ---------------------------------------------------------------------------------------------------------------------
-    void LayerData::_update_dimensions()
+    std::vector<unsigned int> LayerData::_get_channel_order(ColorSpace color_space) const
     {
-        /* Reset all the dimensions back to 0 */
-        top = 0;
-        left = 0;
-        bottom = 0;
-        right = 0;
+        // TODO: Conversion between color profiles could potentially be done here?
 
-        /* Find the extents of the layer canvas */
-        for (auto const &tile : tiles)
+        /* Due to historical reasons the red and blue pixel values are swapped in the case of RGBA & RGBA16 */
+        /* This is to be rectified by using a special vector with swapped values */
+        std::vector<unsigned int> pixel_vector(pixel_size);
+        std::iota(std::begin(pixel_vector), std::end(pixel_vector), 0);
+        if (color_space == ColorSpace::RGBA)
+        {
+            unsigned int bytes_per_channel = 1;
+            std::swap_ranges(pixel_vector.begin(), pixel_vector.begin() + bytes_per_channel, pixel_vector.begin() + 2 * bytes_per_channel);
+        }
+        else if (color_space == ColorSpace::RGBA16)
         {
-            if (tile->left < left)
+            unsigned int bytes_per_channel = 2;
+            std::swap_ranges(pixel_vector.begin(), pixel_vector.begin() + bytes_per_channel, pixel_vector.begin() + 2 * bytes_per_channel);
+        }
+
+        return pixel_vector;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decompress a single tile and interleave its channels straight into the result, consecutive rows of the tile are
+    // written p_row_stride bytes apart so that the tile can be placed anywhere within a larger image
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_decode_tile(size_t p_tile_index, const std::vector<unsigned int> &p_channel_order, std::vector<uint8_t> &p_unsorted_data, uint8_t *p_result, size_t p_row_stride) const
+    {
+        /* Now... the first byte of the data is actually some sort of indicator of compression */
+        /* As follows: */
+        /* 0 -> No compression, the data is actually raw! */
+        /* 1 -> The data was compressed using LZF */
+        /* NOTE: Krita falls back to raw tiles whenever LZF doesn't make the tile any smaller (e.g. for noisy images). */
+        /* Unlike compressed tiles, raw tiles are stored with their channels already interleaved! */
+        const size_t decompressed_length = (size_t)pixel_size * tile_width * tile_height;
+        const size_t tile_row_length = (size_t)pixel_size * tile_width;
+        const uint8_t *compressed_data = _layer_content.data + _tile_offsets[p_tile_index];
+        if (_tile_lengths[p_tile_index] > 0 && compressed_data[0] == 0)
+        {
+            const size_t raw_size = std::min((size_t)_tile_lengths[p_tile_index] - 1, decompressed_length);
+            const uint8_t *raw_data = compressed_data + 1;
+            if (raw_size < decompressed_length)
             {
-                left = tile->left;
+                fprintf(stderr, "ERROR: Raw tile at (%d, %d) is truncated, its missing pixels are left empty\n", _tile_lefts[p_tile_index], _tile_tops[p_tile_index]);
             }
-            if (tile->left + (int32_t)tile_width > right)
+
+            /* Only the channels might have to be swapped, which isn't needed at all for most color spaces */
+            const bool is_in_order = std::is_sorted(p_channel_order.begin(), p_channel_order.end());
+            for (size_t row_index = 0; row_index < tile_height; row_index++)
             {
-                right = tile->left + (int32_t)tile_width;
+                uint8_t *destination = p_result + row_index * p_row_stride;
+                const size_t row_start = row_index * tile_row_length;
+                /* A truncated raw tile is treated the same as a corrupt compressed tile */
+                const size_t row_size = (raw_size > row_start) ? std::min(raw_size - row_start, tile_row_length) : 0;
+                if (is_in_order)
+                {
+                    std::memcpy(destination, raw_data + row_start, row_size);
+                }
+                else
+                {
+                    const size_t row_pixels = row_size / pixel_size;
+                    for (size_t i = 0; i < row_pixels; i++)
+                    {
+                        for (unsigned int j = 0; j < pixel_size; j++)
+                        {
+                            destination[i * pixel_size + j] = raw_data[row_start + i * pixel_size + p_channel_order[j]];
+                        }
+                    }
+                    std::fill(destination + row_pixels * pixel_size, destination + row_size, 0);
+                }
+                std::fill(destination + row_size, destination + tile_row_length, 0);
             }
+            return;
+        }
 
-            if (tile->top < top)
+        const int decompressed_size = _lzff_decompress(compressed_data + 1, _tile_lengths[p_tile_index], p_unsorted_data.data(), (int)decompressed_length);
+        if (decompressed_size != (int)decompressed_length)
+        {
+            fprintf(stderr, "ERROR: Compressed tile at (%d, %d) is corrupt, its missing pixels are left empty\n", _tile_lefts[p_tile_index], _tile_tops[p_tile_index]);
+        }
+        /* The buffer is re-used for every tile, so whatever a (corrupt) tile didn't fill in must not be left over from the previous one */
+        std::fill(p_unsorted_data.begin() + std::max(decompressed_size, 0), p_unsorted_data.begin() + decompressed_length, 0);
+
+        /* Data is saved in following format: */
+        /* (R0 R1 R2...) (G0 G1 G2...) (B0 B1 B2...) (A0 A1 A2...)*/
+        /* which is different from the wanted format: */
+        /* (R0 G0 B0 A0) (R1 G1 B1 A1) (R2 G2 B2 A2)...*/
+
+        /* We'll have to do some sorting as a result!*/
+        /* Every channel of the result simply comes from its own plane, which already takes care of the swapped channels */
+        const size_t tile_area = (size_t)tile_height * tile_width;
+        const uint8_t *unsorted_data = p_unsorted_data.data();
+        for (size_t row_index = 0; row_index < tile_height; row_index++)
+        {
+            const uint8_t *source = unsorted_data + row_index * tile_width;
+            uint8_t *destination = p_result + row_index * p_row_stride;
+            size_t x = 0;
+            if (pixel_size == 4)
             {
-                top = tile->top;
+                /* The most common case (= 8-bit RGBA) interleaves 16 pixels at a time */
+                for (; x + 16 <= tile_width; x += 16)
+                {
+                    _interleave_16_pixels(destination + x * 4, source + p_channel_order[0] * tile_area + x, source + p_channel_order[1] * tile_area + x,
+                                          source + p_channel_order[2] * tile_area + x, source + p_channel_order[3] * tile_area + x);
+                }
             }
-            if (tile->top + (int32_t)tile_height > bottom)
+            for (; x < tile_width; x++)
             {
-                bottom = tile->top + (int32_t)tile_height;
+                for (unsigned int j = 0; j < pixel_size; j++)
+                {
+                    destination[x * pixel_size + j] = source[p_channel_order[j] * tile_area + x];
+                }
             }
         }
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Decompression function for LZF copied directly (with minor modifications) from the Krita codebase (libs\image\tiles3\swap\kis_lzf_compression.cpp)
+    // Fill a run of pixels with the same (already interleaved) pixel, e.g. the default pixel or that of a uniform tile
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_fill_pixels(uint8_t *p_result, size_t p_pixel_count, const uint8_t *p_pixel) const
+    {
+        const size_t length = p_pixel_count * pixel_size;
+        size_t i = 0;
+        if (pixel_size > 0 && 16 % pixel_size == 0)
+        {
+            /* Pixel sizes that divide 16 (e.g. 8-bit RGBA) are stored 16 bytes at a time, just like memset would */
+            uint8_t pattern[16];
+            for (size_t j = 0; j < 16; j++)
+            {
+                pattern[j] = p_pixel[j % pixel_size];
+            }
+            i = length - length % 16;
+            _repeat_16_bytes(p_result, pattern, i, 16);
+        }
+        for (; i < length; i += pixel_size)
+        {
+            std::memcpy(p_result + i, p_pixel, pixel_size);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Build the dense grid of tile indices, which maps every tile-sized cell of the layer's extents to the tile covering it
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_build_tile_grid()
+    {
+        /* NOTE: Misaligned tiles were already left out, so the extents are a whole number of tiles in each direction */
+        _grid_columns = get_width() / tile_width;
+        _grid_rows = get_height() / tile_height;
+
+        /* The extents come straight from the tile headers, so a single far-away tile could otherwise require a huge grid */
+        if ((uint64_t)_grid_columns * _grid_rows > MAX_GRID_CELLS)
+        {
+            throw std::out_of_range("Tile grid of layer content is too large");
+        }
+        _tile_grid.assign((size_t)_grid_columns * _grid_rows, INVALID_TILE_INDEX);
+
+        for (size_t tile_index = 0; tile_index < _tile_offsets.size(); tile_index++)
+        {
+            const unsigned int column = (unsigned int)(((int64_t)_tile_lefts[tile_index] - left) / tile_width);
+            const unsigned int row = (unsigned int)(((int64_t)_tile_tops[tile_index] - top) / tile_height);
+            if (column < _grid_columns && row < _grid_rows)
+            {
+                /* A later tile at the same position overwrites an earlier one, just like composing the tiles one after another would */
+                _tile_grid[(size_t)row * _grid_columns + column] = (uint32_t)tile_index;
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find the tiles of the grid that have exactly the same compressed data (e.g. transparent or flat tiles), so that
+    // every distinct tile only has to be decoded once
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_find_duplicate_tiles() const
+    {
+        _tile_sources.resize(_tile_offsets.size());
+        std::iota(_tile_sources.begin(), _tile_sources.end(), 0);
+        _unique_tile_count = 0;
+
+        /* Open-addressing hash table of the first tile with every distinct content, which only needs a single allocation */
+        size_t capacity = 16;
+        while (capacity < _tile_offsets.size() * 2)
+        {
+            capacity *= 2;
+        }
+        std::vector<uint32_t> slots(capacity, INVALID_TILE_INDEX);
+        std::vector<uint64_t> hashes(_tile_offsets.size());
+
+        for (uint32_t tile_index : _tile_grid)
+        {
+            if (tile_index == INVALID_TILE_INDEX)
+            {
+                continue;
+            }
+
+            /* The compression flag is part of the hashed data, as a raw & a compressed tile can never be compared */
+            const uint8_t *data = _layer_content.data + _tile_offsets[tile_index];
+            const uint32_t length = _tile_lengths[tile_index];
+            hashes[tile_index] = _hash_bytes(data, length);
+
+            size_t slot = hashes[tile_index] & (capacity - 1);
+            while (slots[slot] != INVALID_TILE_INDEX)
+            {
+                const uint32_t other_index = slots[slot];
+                if (hashes[other_index] == hashes[tile_index] && _tile_lengths[other_index] == length &&
+                    std::memcmp(_layer_content.data + _tile_offsets[other_index], data, length) == 0)
+                {
+                    _tile_sources[tile_index] = other_index;
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            if (slots[slot] == INVALID_TILE_INDEX)
+            {
+                slots[slot] = tile_index;
+                _unique_tile_count++;
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find the tiles of the grid of which every pixel has the same value, duplicates of a uniform tile are uniform as well
+    // so only the unique tiles are actually looked at
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_find_uniform_tiles() const
+    {
+        _uniform_pixel_indices.assign(_tile_offsets.size(), INVALID_TILE_INDEX);
+        _uniform_pixels.clear();
+        _uniform_tile_count = 0;
+
+        std::vector<uint8_t> pixel(pixel_size);
+        for (uint32_t tile_index : _tile_grid)
+        {
+            if (tile_index == INVALID_TILE_INDEX)
+            {
+                continue;
+            }
+
+            /* The tile a duplicate refers to always comes earlier in the grid, so it has already been looked at */
+            const uint32_t source_index = _tile_sources[tile_index];
+            if (source_index != tile_index)
+            {
+                _uniform_pixel_indices[tile_index] = _uniform_pixel_indices[source_index];
+            }
+            else if (_get_uniform_pixel(tile_index, pixel.data()))
+            {
+                _uniform_pixel_indices[tile_index] = (uint32_t)(_uniform_pixels.size() / pixel_size);
+                _uniform_pixels.insert(_uniform_pixels.end(), pixel.begin(), pixel.end());
+            }
+
+            if (_uniform_pixel_indices[tile_index] != INVALID_TILE_INDEX)
+            {
+                _uniform_tile_count++;
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find all duplicate & uniform tiles if this didn't happen yet, which is only done once even if called concurrently
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_analyze_tiles() const
+    {
+        std::call_once(_tile_analysis_flag, [this]()
+                       {
+                           _find_duplicate_tiles();
+                           _find_uniform_tiles(); });
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Check whether every pixel of a compressed tile has the same value by following its LZF stream, without ever writing
+    // the decompressed data. A flat tile is compressed into a single literal per channel followed by long back references,
+    // so this gives up as soon as any byte differs from the rest of its channel. Raw, truncated & corrupt tiles (or tiles
+    // the decoder would zero-fill partly) are never reported as uniform, they still go through _decode_tile() as before.
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool LayerData::_get_uniform_pixel(size_t p_tile_index, uint8_t *p_pixel) const
+    {
+        const size_t tile_area = (size_t)tile_width * tile_height;
+        const size_t decompressed_length = tile_area * pixel_size;
+        const uint8_t *compressed_data = _layer_content.data + _tile_offsets[p_tile_index];
+        if (tile_area == 0 || _tile_lengths[p_tile_index] < 2 || compressed_data[0] == 0)
+        {
+            return false;
+        }
+
+        /* The decompressed data consists of one plane per channel, every byte of a plane has to match its first byte */
+        /* As the output is only ever appended to, all bytes before 'position' are known to have their plane's value */
+        const uint8_t *ip = compressed_data + 1;
+        const uint8_t *ip_limit = compressed_data + _tile_lengths[p_tile_index];
+        size_t position = 0;
+        auto write_run = [&](size_t p_length, uint8_t p_value)
+        {
+            /* The run can cross into the next plane(s), in which case the value becomes their first byte */
+            while (p_length > 0)
+            {
+                const size_t plane = position / tile_area;
+                const size_t plane_offset = position % tile_area;
+                if (plane_offset == 0)
+                {
+                    p_pixel[plane] = p_value;
+                }
+                else if (p_pixel[plane] != p_value)
+                {
+                    return false;
+                }
+
+                const size_t step = std::min(p_length, tile_area - plane_offset);
+                position += step;
+                p_length -= step;
+            }
+            return true;
+        };
+
+        while (ip < ip_limit)
+        {
+            unsigned int ctrl = (*ip) + 1;
+            unsigned int ofs = ((*ip) & 31) << 8;
+            unsigned int len = (*ip++) >> 5;
+
+            if (ctrl < 33)
+            {
+                /* literal run, which also has to lie completely within the tile's data */
+                if (position + ctrl > decompressed_length || ip + ctrl > ip_limit)
+                {
+                    return false;
+                }
+                for (; ctrl; ctrl--)
+                {
+                    if (!write_run(1, *ip++))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else
+            {
+                /* back reference */
+                len--;
+                if (len == 7 - 1)
+                {
+                    if (ip >= ip_limit)
+                    {
+                        return false;
+                    }
+                    len += *ip++;
+                }
+                if (ip >= ip_limit)
+                {
+                    return false;
+                }
+                const size_t distance = (size_t)ofs + 1 + *ip++;
+                const size_t copy_length = len + 3;
+                if (position + copy_length > decompressed_length || distance > position)
+                {
+                    return false;
+                }
+
+                /* The referenced bytes (which get repeated if they overlap the output) can only span a few planes */
+                /* If all of those planes have the same value, the whole back reference is a single run of that value */
+                const size_t reference = position - distance;
+                const size_t first_plane = reference / tile_area;
+                const size_t last_plane = (reference + std::min(copy_length, distance) - 1) / tile_area;
+                const uint8_t value = p_pixel[first_plane];
+                for (size_t plane = first_plane + 1; plane <= last_plane; plane++)
+                {
+                    if (p_pixel[plane] != value)
+                    {
+                        return false;
+                    }
+                }
+                if (!write_run(copy_length, value))
+                {
+                    return false;
+                }
+            }
+        }
+
+        /* Anything the stream didn't fill in is zeroed by the decoder, so the tile has to be completely filled */
+        return position == decompressed_length;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Go through all the tiles and find the layer's extents
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerData::_update_dimensions()
+    {
+        /* The extents are found with 64-bit integers, as a tile near the limits of int32_t would otherwise overflow them */
+        /* The layer canvas always includes the origin, just like before */
+        int64_t extent_top = 0;
+        int64_t extent_left = 0;
+        int64_t extent_bottom = 0;
+        int64_t extent_right = 0;
+
+        /* Find the extents of the layer canvas */
+        for (int32_t tile_left : _tile_lefts)
+        {
+            extent_left = std::min(extent_left, (int64_t)tile_left);
+            extent_right = std::max(extent_right, (int64_t)tile_left + tile_width);
+        }
+
+        for (int32_t tile_top : _tile_tops)
+        {
+            extent_top = std::min(extent_top, (int64_t)tile_top);
+            extent_bottom = std::max(extent_bottom, (int64_t)tile_top + tile_height);
+        }
+
+        /* Both the extents and the width & height that follow from them have to fit in an int32_t */
+        if (extent_right > INT32_MAX || extent_bottom > INT32_MAX || extent_right - extent_left > INT32_MAX || extent_bottom - extent_top > INT32_MAX)
+        {
+            throw std::out_of_range("Tile positions in layer content exceed the supported layer extents");
+        }
+
+        top = (int32_t)extent_top;
+        left = (int32_t)extent_left;
+        bottom = (int32_t)extent_bottom;
+        right = (int32_t)extent_right;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decompression function for LZF based on the Krita codebase (libs\image\tiles3\swap\kis_lzf_compression.cpp)
+    // Literals & back references are copied 16 bytes at a time, so the output buffer needs LZF_OUTPUT_PADDING bytes more
+    // than maxout. Whatever ends up beyond the returned size (but within the buffer) is garbage & has to be overwritten!
     // ---------------------------------------------------------------------------------------------------------------------
     int LayerData::_lzff_decompress(const void *input, const int length, void *output, int maxout) const
     {
@@ -301,26 +1168,18 @@ namespace kra
                 if (op + ctrl > op_limit)
                     return 0;
 
-                /* crazy unrolling */
-                if (ctrl)
+                /* A literal is never longer than 32 bytes, so it can be copied as a whole unless that reads past the input */
+                if (ip + 32 <= ip_limit)
                 {
-                    *op++ = *ip++;
-                    ctrl--;
-
-                    if (ctrl)
-                    {
+                    _copy_16_bytes(op, ip);
+                    _copy_16_bytes(op + 16, ip + 16);
+                    op += ctrl;
+                    ip += ctrl;
+                }
+                else
+                {
+                    for (; ctrl; ctrl--)
                         *op++ = *ip++;
-                        ctrl--;
-
-                        if (ctrl)
-                        {
-                            *op++ = *ip++;
-                            ctrl--;
-
-                            for (; ctrl; ctrl--)
-                                *op++ = *ip++;
-                        }
-                    }
                 }
             }
             else
@@ -341,12 +1200,28 @@ namespace kra
                 if (ref < (unsigned char *)output)
                     return 0;
 
-                *op++ = *ref++;
-                *op++ = *ref++;
-                *op++ = *ref++;
-                if (len)
-                    for (; len; --len)
-                        *op++ = *ref++;
+                const size_t copy_length = len + 3;
+                const size_t distance = (size_t)(op - ref);
+                if (distance >= 16)
+                {
+                    /* Every chunk only reads bytes that were completely written before */
+                    for (size_t i = 0; i < copy_length; i += 16)
+                    {
+                        _copy_16_bytes(op + i, ref + i);
+                    }
+                }
+                else
+                {
+                    /* The reference overlaps the output, which means the last 'distance' bytes simply get repeated */
+                    /* The pattern is stored at a multiple of its period, so that every store writes the same 16 bytes */
+                    uint8_t pattern[16];
+                    for (size_t i = 0; i < 16; i++)
+                    {
+                        pattern[i] = (i < distance) ? ref[i] : pattern[i - distance];
+                    }
+                    _repeat_16_bytes(op, pattern, copy_length, 16 - 16 % distance);
+                }
+                op += copy_length;
             }
         }
 
@@ -9,45 +9,90 @@
 
 #include "kra_utility.h"
 
+#include "kra_archive.h"
+
 #include <memory>
-#include <regex>
+#include <mutex>
+#include <stdexcept>
 #include <numeric>
 
 #define WRITEBUFFERSIZE (8192)
+/* Number of bytes the LZF decoder is allowed to write past the end of its output */
+#define LZF_OUTPUT_PADDING (32)
+/* Minimum number of tiles every thread has to compose, as starting a thread for only a handful of tiles isn't worth it */
+#define MIN_TILES_PER_THREAD (64)
+/* Largest tile & pixel size that is accepted, Krita itself always uses 64x64 tiles with no more than 20 bytes per pixel */
+#define MAX_TILE_SIZE (4096)
+#define MAX_PIXEL_SIZE (64)
+/* Largest number of cells in a layer's tile grid, which already corresponds to a layer of over 68 gigapixels */
+#define MAX_GRID_CELLS (1 << 24)
 
 namespace kra
 {
     /* This class contains the actual data as stored in the layer's unique binary file */
     class LayerData
     {
-    private:
-        class Tile
-        {
-        public:
-            // These can also be negative!!!
-            // The left (X) position of the tile.
-            int32_t left;
-            // The top (Y) position of the tile.
-            int32_t top;
-
-            // Number of compressed bytes that represent the tile data.
-            int compressed_length;
-
-            // Compressed image data of this tile.
-            std::vector<uint8_t> compressed_data;
-        };
+        /* The sampler decodes single tiles straight from the tile grid */
+        friend class LayerSampler;
 
-        std::vector<std::unique_ptr<Tile>> tiles;
+    private:
+        /* The complete (still compressed) content of the layer's entry, the data of every tile points into it */
+        EntryData _layer_content;
+
+        /* Every tile has the same index in each of these vectors */
+        // The left (X) position of every tile, these can also be negative!!!
+        std::vector<int32_t> _tile_lefts;
+        // The top (Y) position of every tile, these can also be negative!!!
+        std::vector<int32_t> _tile_tops;
+        // Position of every tile's compressed data within the layer's content.
+        std::vector<size_t> _tile_offsets;
+        // Number of compressed bytes that represent every tile's data.
+        std::vector<uint32_t> _tile_lengths;
+
+        /* Dense grid with a cell for every tile-sized area of the layer's extents, stored row after row */
+        /* Every cell contains the index of the tile that covers it, or INVALID_TILE_INDEX if there's no such tile */
+        std::vector<uint32_t> _tile_grid;
+        unsigned int _grid_columns = 0;
+        unsigned int _grid_rows = 0;
+
+        /* Every tile refers to the first tile of the grid that has exactly the same compressed data, which is only decoded once */
+        /* Unique tiles (and tiles that were overwritten by a later tile at the same position) simply refer to themselves */
+        /* NOTE: These are only filled in when first needed, as hashing every tile while loading would touch all of the layer's */
+        /* content, even for memory-mapped archives of which the tiles might never be decoded at all! */
+        mutable std::once_flag _tile_analysis_flag;
+        mutable std::vector<uint32_t> _tile_sources;
+        mutable size_t _unique_tile_count = 0;
+
+        /* Tiles of which every pixel has the same value (e.g. transparent or flat tiles) are filled instead of decoded */
+        /* Every tile either contains the index of its pixel within _uniform_pixels, or INVALID_TILE_INDEX if it isn't uniform */
+        mutable std::vector<uint32_t> _uniform_pixel_indices;
+        /* The pixel of every distinct uniform tile, with its channels in the same order as stored in the layer's content */
+        mutable std::vector<uint8_t> _uniform_pixels;
+        mutable size_t _uniform_tile_count = 0;
+
+        /* Value of every pixel that isn't covered by any tile, as stored in the layer's '.defaultpixel'-entry */
+        /* NOTE: This is left empty if the default pixel is completely transparent (= all zeroes), which is the most common case */
+        std::vector<uint8_t> _default_pixel;
 
         int32_t top;
         int32_t left;
         int32_t bottom;
         int32_t right;
 
-        unsigned int _get_element_value(const std::vector<unsigned char> &p_layer_content, const std::string &p_element_name, unsigned int &p_index) const;
-        std::string _get_header_line(const std::vector<unsigned char> &p_layer_content, unsigned int &p_index) const;
+        unsigned int _get_element_value(const uint8_t *p_layer_content, size_t p_size, const std::string &p_element_name, size_t &p_index) const;
+        void _parse_tile_header(const uint8_t *p_layer_content, size_t p_size, size_t &p_index, int32_t &p_left, int32_t &p_top, int32_t &p_length) const;
 
         void _update_dimensions();
+        void _build_tile_grid();
+        void _find_duplicate_tiles() const;
+        void _find_uniform_tiles() const;
+        void _analyze_tiles() const;
+        bool _get_uniform_pixel(size_t p_tile_index, uint8_t *p_pixel) const;
+
+        std::vector<unsigned int> _get_channel_order(ColorSpace color_space) const;
+        /* NOTE: The unsorted data needs room for one decompressed tile plus LZF_OUTPUT_PADDING bytes! */
+        void _decode_tile(size_t p_tile_index, const std::vector<unsigned int> &p_channel_order, std::vector<uint8_t> &p_unsorted_data, uint8_t *p_result, size_t p_row_stride) const;
+        void _fill_pixels(uint8_t *p_result, size_t p_pixel_count, const uint8_t *p_pixel) const;
 
         int _lzff_decompress(const void *input, const int length, void *output, int maxout) const;
 
@@ -61,9 +106,19 @@ namespace kra
         // Number of elements in each pixel, is equal to 4 for RGBA.
         unsigned int pixel_size;
 
-        void import_attributes(const std::vector<unsigned char> &p_layer_content);
+        void import_attributes(const uint8_t *p_layer_content, size_t p_size);
+        void import_attributes(EntryData &&p_layer_content);
+        void import_default_pixel(const uint8_t *p_data, size_t p_size);
+
+        std::vector<uint8_t> get_composed_data(ColorSpace color_space, unsigned int p_thread_count = 0) const;
+        std::vector<uint8_t> get_composed_region(int32_t p_x, int32_t p_y, unsigned int p_width, unsigned int p_height, ColorSpace color_space) const;
+
+        uint32_t find_tile(int32_t p_x, int32_t p_y) const;
+        std::vector<uint8_t> get_default_pixel(ColorSpace color_space) const;
 
-        std::vector<uint8_t> get_composed_data(ColorSpace color_space) const;
+        size_t get_tile_count() const;
+        size_t get_unique_tile_count() const;
+        size_t get_uniform_tile_count() const;
 
         unsigned int get_width() const;
         unsigned int get_height() const;
@@ -0,0 +1,216 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_layer_sampler.h"
+
+#include <algorithm>
+
+namespace kra
+{
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the size of a single (8-bit per channel by default) pixel in the given color space, used when there's no layer data
+    // ---------------------------------------------------------------------------------------------------------------------
+    static unsigned int _get_color_space_pixel_size(ColorSpace p_color_space)
+    {
+        switch(p_color_space)
+        {
+            case RGBA16:
+            case RGBAF16:
+                return 8;
+            case RGBAF32:
+                return 16;
+            case CMYK:
+                return 5;
+            default:
+                return 4;
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Create a sampler for the given layer, its tile data is extracted immediately if the document was loaded lazily
+    // ---------------------------------------------------------------------------------------------------------------------
+    LayerSampler::LayerSampler(const Layer &p_layer, size_t p_cache_size) : _cache_size(std::max(p_cache_size, (size_t)1))
+    {
+        _pixel_size = _get_color_space_pixel_size(p_layer.color_space);
+        if (p_layer.type != PAINT_LAYER)
+        {
+            return;
+        }
+
+        _layer_data = p_layer.get_layer_data();
+        if (_layer_data == nullptr)
+        {
+            return;
+        }
+
+        _pixel_size = _layer_data->pixel_size;
+
+        /* The tiles are stored relative to the layer's position, not relative to the document */
+        _offset_x = (int32_t)p_layer.x;
+        _offset_y = (int32_t)p_layer.y;
+
+        _channel_order = _layer_data->_get_channel_order(p_layer.color_space);
+        _default_pixel = _layer_data->get_default_pixel(p_layer.color_space);
+        _unsorted_data.resize(_layer_data->pixel_size * _layer_data->tile_width * _layer_data->tile_height + LZF_OUTPUT_PADDING);
+        _cache.reserve(_cache_size);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Sample a single pixel at the given document coordinates, the result needs room for get_pixel_size() bytes
+    // Returns false (and the layer's default pixel, or a transparent one without layer data) if no tile covers the given coordinates
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool LayerSampler::sample(int32_t p_x, int32_t p_y, uint8_t *p_result)
+    {
+        if (_layer_data == nullptr)
+        {
+            std::memset(p_result, 0, _pixel_size);
+            return false;
+        }
+
+        const unsigned int pixel_size = _layer_data->pixel_size;
+        const int64_t x = (int64_t)p_x - _offset_x;
+        const int64_t y = (int64_t)p_y - _offset_y;
+        const uint32_t tile_index = _find_tile(x, y);
+        if (tile_index == INVALID_TILE_INDEX)
+        {
+            std::memcpy(p_result, _default_pixel.data(), pixel_size);
+            return false;
+        }
+
+        const uint8_t *tile = _get_tile(tile_index);
+        const size_t tile_x = (size_t)(x - _layer_data->_tile_lefts[tile_index]);
+        const size_t tile_y = (size_t)(y - _layer_data->_tile_tops[tile_index]);
+        std::memcpy(p_result, tile + (tile_y * _layer_data->tile_width + tile_x) * pixel_size, pixel_size);
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Sample a horizontal span of pixels starting at the given document coordinates, the result needs room for
+    // p_length * get_pixel_size() bytes. Pixels that aren't covered by any tile get the layer's default pixel.
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerSampler::sample_span(int32_t p_x, int32_t p_y, unsigned int p_length, uint8_t *p_result)
+    {
+        if (_layer_data == nullptr)
+        {
+            std::memset(p_result, 0, (size_t)p_length * _pixel_size);
+            return;
+        }
+
+        const unsigned int pixel_size = _layer_data->pixel_size;
+        const int64_t y = (int64_t)p_y - _offset_y;
+        int64_t x = (int64_t)p_x - _offset_x;
+        const int64_t end = x + p_length;
+        while (x < end)
+        {
+            /* Every step handles the part of the span that lies within a single tile-sized column of the grid */
+            const int64_t column_offset = ((x - _layer_data->left) % (int64_t)_layer_data->tile_width + _layer_data->tile_width) % _layer_data->tile_width;
+            const int64_t step = std::min((int64_t)_layer_data->tile_width - column_offset, end - x);
+            const uint32_t tile_index = _find_tile(x, y);
+            if (tile_index == INVALID_TILE_INDEX)
+            {
+                _layer_data->_fill_pixels(p_result, (size_t)step, _default_pixel.data());
+            }
+            else
+            {
+                const uint8_t *tile = _get_tile(tile_index);
+                const size_t tile_x = (size_t)(x - _layer_data->_tile_lefts[tile_index]);
+                const size_t tile_y = (size_t)(y - _layer_data->_tile_tops[tile_index]);
+                std::memcpy(p_result, tile + (tile_y * _layer_data->tile_width + tile_x) * pixel_size, step * pixel_size);
+            }
+
+            p_result += step * pixel_size;
+            x += step;
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Helper functions for accessing the sampler's properties & statistics
+    // ---------------------------------------------------------------------------------------------------------------------
+    unsigned int LayerSampler::get_pixel_size() const
+    {
+        return _pixel_size;
+    }
+
+    size_t LayerSampler::get_hit_count() const
+    {
+        return _hit_count;
+    }
+
+    size_t LayerSampler::get_miss_count() const
+    {
+        return _miss_count;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Release all decoded tiles, after which every tile has to be decoded again
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LayerSampler::clear()
+    {
+        _cache.clear();
+        _last_cached_tile = 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Find the tile covering the given layer coordinates, these can lie far outside of the layer after removing its offset
+    // ---------------------------------------------------------------------------------------------------------------------
+    uint32_t LayerSampler::_find_tile(int64_t p_x, int64_t p_y) const
+    {
+        if (p_x < INT32_MIN || p_x > INT32_MAX || p_y < INT32_MIN || p_y > INT32_MAX)
+        {
+            return INVALID_TILE_INDEX;
+        }
+
+        return _layer_data->find_tile((int32_t)p_x, (int32_t)p_y);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the decoded (and interleaved) data of a tile, decoding it into the least recently used cache entry if needed
+    // ---------------------------------------------------------------------------------------------------------------------
+    const uint8_t *LayerSampler::_get_tile(uint32_t p_tile_index)
+    {
+        _clock++;
+
+        /* The cache is tiny, so a linear search is faster than any kind of map */
+        if (_last_cached_tile < _cache.size() && _cache[_last_cached_tile].tile_index == p_tile_index)
+        {
+            _hit_count++;
+            _cache[_last_cached_tile].last_use = _clock;
+            return _cache[_last_cached_tile].data.data();
+        }
+
+        size_t victim = 0;
+        for (size_t i = 0; i < _cache.size(); i++)
+        {
+            if (_cache[i].tile_index == p_tile_index)
+            {
+                _hit_count++;
+                _cache[i].last_use = _clock;
+                _last_cached_tile = i;
+                return _cache[i].data.data();
+            }
+
+            if (_cache[i].last_use < _cache[victim].last_use)
+            {
+                victim = i;
+            }
+        }
+
+        _miss_count++;
+        if (_cache.size() < _cache_size)
+        {
+            victim = _cache.size();
+            _cache.emplace_back();
+            _cache[victim].data.resize(_unsorted_data.size() - LZF_OUTPUT_PADDING);
+        }
+
+        CachedTile &cached_tile = _cache[victim];
+        _layer_data->_decode_tile(p_tile_index, _channel_order, _unsorted_data, cached_tile.data.data(), (size_t)_layer_data->tile_width * _layer_data->pixel_size);
+        cached_tile.tile_index = p_tile_index;
+        cached_tile.last_use = _clock;
+        _last_cached_tile = victim;
+        return cached_tile.data.data();
+    }
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_LAYER_SAMPLER_H
+#define KRA_LAYER_SAMPLER_H
+
+#include "kra_utility.h"
+
+#include "kra_layer.h"
+#include "kra_layer_data.h"
+
+namespace kra
+{
+    /* Number of decoded tiles a LayerSampler keeps around by default, which is 256 kB for a RGBA layer */
+    const size_t DEFAULT_SAMPLER_CACHE_SIZE = 16;
+
+    /* This class reads single pixels (or short horizontal spans) of a PAINT_LAYER at document coordinates */
+    /* Only the tiles that are actually sampled get decoded, the most recently used ones are kept in a small cache */
+    /* NOTE: A LayerSampler isn't thread-safe, every thread should use its own sampler for the same layer! */
+    class LayerSampler
+    {
+    private:
+        class CachedTile
+        {
+        public:
+            uint32_t tile_index = INVALID_TILE_INDEX;
+            /* Value of the sampler's clock when this tile was last used, the tile with the lowest value is evicted first */
+            uint64_t last_use = 0;
+            std::vector<uint8_t> data;
+        };
+
+        /* This stays nullptr for group layers and paint layers without any tile data, every sample is transparent then */
+        const LayerData *_layer_data = nullptr;
+        /* The layer's position within the document, which is subtracted from the document coordinates */
+        int32_t _offset_x = 0;
+        int32_t _offset_y = 0;
+        /* Taken from the layer data, or from the layer's color space if there isn't any */
+        unsigned int _pixel_size = 0;
+
+        std::vector<unsigned int> _channel_order;
+        std::vector<uint8_t> _default_pixel;
+        std::vector<uint8_t> _unsorted_data;
+
+        std::vector<CachedTile> _cache;
+        size_t _cache_size;
+        /* Index (within the cache) of the tile that was used last, as consecutive samples usually hit the same tile */
+        size_t _last_cached_tile = 0;
+        uint64_t _clock = 0;
+
+        size_t _hit_count = 0;
+        size_t _miss_count = 0;
+
+        uint32_t _find_tile(int64_t p_x, int64_t p_y) const;
+        const uint8_t *_get_tile(uint32_t p_tile_index);
+
+    public:
+        LayerSampler(const Layer &p_layer, size_t p_cache_size = DEFAULT_SAMPLER_CACHE_SIZE);
+
+        bool sample(int32_t p_x, int32_t p_y, uint8_t *p_result);
+        void sample_span(int32_t p_x, int32_t p_y, unsigned int p_length, uint8_t *p_result);
+
+        unsigned int get_pixel_size() const;
+
+        size_t get_hit_count() const;
+        size_t get_miss_count() const;
+
+        void clear();
+    };
+};
+
+#endif // KRA_LAYER_SAMPLER_H
\ No newline at end of file
@@ -0,0 +1,58 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_load_options.h"
+
+#include "kra_layer.h"
+#include "kra_uuid.h"
+
+#include <algorithm>
+
+namespace kra
+{
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Compare two UUIDs by their value, so that neither the case of the digits nor the braces around them have to match
+    // Only if either of them isn't a valid UUID, both are compared as plain text instead
+    // ---------------------------------------------------------------------------------------------------------------------
+    static bool _is_same_uuid(std::string_view p_filter_uuid, std::string_view p_layer_uuid)
+    {
+        Uuid filter_uuid;
+        Uuid layer_uuid;
+        if (Uuid::parse(p_filter_uuid, filter_uuid) && Uuid::parse(p_layer_uuid, layer_uuid))
+        {
+            return filter_uuid == layer_uuid;
+        }
+
+        return p_filter_uuid == p_layer_uuid;
+    }
+
+    bool LayerFilter::is_empty() const
+    {
+        return uuids.empty() && names.empty() && paths.empty() && !predicate;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Check whether the given layer, found at the given path in the layer tree, is selected by this filter
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool LayerFilter::matches(const Layer &p_layer, const std::string &p_path) const
+    {
+        if (std::any_of(uuids.begin(), uuids.end(), [&](const std::string &p_uuid)
+                        { return _is_same_uuid(p_uuid, p_layer.uuid); }))
+        {
+            return true;
+        }
+        if (std::find(names.begin(), names.end(), p_layer.name) != names.end())
+        {
+            return true;
+        }
+        if (std::find(paths.begin(), paths.end(), p_path) != paths.end())
+        {
+            return true;
+        }
+
+        return predicate && predicate(p_layer, p_path);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,76 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_LOAD_OPTIONS_H
+#define KRA_LOAD_OPTIONS_H
+
+#include "kra_utility.h"
+
+#include "../tinyxml2/tinyxml2.h"
+
+#include <functional>
+#include <memory>
+
+namespace kra
+{
+    class Layer;
+
+    enum LoadMode
+    {
+        /* The tile data of every paint layer is extracted while loading */
+        FULL_LOAD,
+        /* The archive stays open and the tile data of a paint layer is only extracted when it's first needed */
+        LAZY_LOAD,
+        /* Only 'maindoc.xml' is extracted, paint layers never get any tile data */
+        METADATA_ONLY
+    };
+
+    enum ExtractionMode
+    {
+        /* Layer entries are extracted one after another through a single archive handle */
+        SEQUENTIAL_EXTRACTION,
+        /* Layer entries are extracted concurrently, each worker thread using its own archive handle */
+        PARALLEL_EXTRACTION,
+        /* Layer entries are already extracted & indexed on worker threads while 'maindoc.xml' is still being walked */
+        PIPELINED_EXTRACTION
+    };
+
+    /* This class selects the layers that should be loaded, an empty filter selects every layer of the document */
+    /* A layer is selected if any of the criteria matches it, a selected group layer always keeps all of its children */
+    class LayerFilter
+    {
+    public:
+        /* Compared by their value, so both upper- and lowercase digits are accepted, with or without curly braces */
+        std::vector<std::string> uuids;
+        std::vector<std::string> names;
+        /* Names of the layer and all of its ancestors separated by a slash, e.g. "Group/Sub/Layer" */
+        std::vector<std::string> paths;
+        /* Called with the layer's attributes (as found in 'maindoc.xml') and its path, before any tile data is extracted */
+        std::function<bool(const Layer &, const std::string &)> predicate;
+
+        bool is_empty() const;
+        bool matches(const Layer &p_layer, const std::string &p_path) const;
+    };
+
+    /* This class bundles all the settings that change how a Document gets loaded */
+    class LoadOptions
+    {
+    public:
+        LoadMode load_mode = FULL_LOAD;
+        ExtractionMode extraction_mode = SEQUENTIAL_EXTRACTION;
+        /* Maximum number of layers (and extracted entries) waiting between two stages when using PIPELINED_EXTRACTION */
+        unsigned int pipeline_queue_capacity = 4;
+        LayerFilter layer_filter;
+        /* Keep the (still compressed) 'mergedimage.png' around so that Document::get_merged_image() can decode it later on */
+        /* NOTE: This isn't needed when loading lazily, as the archive stays open anyway! */
+        bool load_merged_image = false;
+        /* Re-used for parsing 'maindoc.xml' when set, so that its memory pools are only allocated once when loading many documents in a row */
+        /* NOTE: Never share the same XMLDocument between loads that run concurrently! */
+        std::shared_ptr<tinyxml2::XMLDocument> xml_document;
+    };
+};
+
+#endif // KRA_LOAD_OPTIONS_H
\ No newline at end of file
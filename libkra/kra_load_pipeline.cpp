@@ -0,0 +1,247 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_load_pipeline.h"
+
+namespace kra
+{
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the number of milliseconds that passed since the given point in time
+    // ---------------------------------------------------------------------------------------------------------------------
+    static double _get_elapsed_time(std::chrono::steady_clock::time_point p_start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p_start).count();
+    }
+
+    LoadPipeline::LoadPipeline(Archive &p_archive, size_t p_queue_capacity)
+        : _archive(p_archive), _layer_queue(p_queue_capacity), _entry_queue(p_queue_capacity), _error_code(UNZ_OK)
+    {
+    }
+
+    LoadPipeline::~LoadPipeline()
+    {
+        /* Only happens when the walk was interrupted, any errors of the other stages are lost at that point anyway */
+        _join();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Start the inflate & index stages, layers can only be pushed once the name of the document is known
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::start(const std::string &p_document_name)
+    {
+        if (_is_started)
+        {
+            return;
+        }
+        _is_started = true;
+        _document_name = p_document_name;
+        _start_time = std::chrono::steady_clock::now();
+
+        /* Inflating is by far the slowest stage, so it gets all threads but one for the (much cheaper) index stage */
+        /* NOTE: The calling thread isn't counted, as walking the XML-file is done long before the other stages are! */
+        const unsigned int thread_count = get_thread_count();
+        const size_t inflate_worker_count = thread_count > 1 ? thread_count - 1 : 1;
+
+        /* The first inflate worker can simply re-use the handle that is already opened */
+        for (size_t i = 1; i < inflate_worker_count; i++)
+        {
+            std::unique_ptr<Archive> worker_archive = std::make_unique<Archive>();
+            if (worker_archive->open(_archive) != 0)
+            {
+                fprintf(stderr, "ERROR: Failed to open an additional handle to the KRA/KRZ archive\n");
+                break;
+            }
+            _worker_archives.push_back(std::move(worker_archive));
+        }
+
+        _inflate_statistics.resize(_worker_archives.size() + 1);
+        /* The last exception slot belongs to the index stage */
+        _exceptions.resize(_worker_archives.size() + 2);
+
+        _index_thread = std::thread(&LoadPipeline::_index, this);
+        _inflate_threads.emplace_back(&LoadPipeline::_inflate, this, 0, std::ref(_archive));
+        for (size_t i = 0; i < _worker_archives.size(); i++)
+        {
+            _inflate_threads.emplace_back(&LoadPipeline::_inflate, this, i + 1, std::ref(*_worker_archives[i]));
+        }
+    }
+
+    bool LoadPipeline::is_started() const
+    {
+        return _is_started;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Queue a paint layer for extraction, blocks for as long as the inflate stage can't keep up
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::push(Layer *p_layer)
+    {
+        auto start = std::chrono::steady_clock::now();
+        _layer_queue.push(p_layer);
+        _walk_statistics.idle_time += _get_elapsed_time(start);
+        _walk_statistics.item_count++;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Wait until every queued layer got its tile data, exceptions of the other stages are re-thrown on the calling thread
+    // ---------------------------------------------------------------------------------------------------------------------
+    int LoadPipeline::finish()
+    {
+        if (!_is_started)
+        {
+            return UNZ_OK;
+        }
+
+        /* Everything up until now was spent walking the XML-file, except for the time that the walk had to wait */
+        _walk_statistics.busy_time = _get_elapsed_time(_start_time) - _walk_statistics.idle_time;
+
+        _join();
+        _total_time = _get_elapsed_time(_start_time);
+
+        for (auto const &exception : _exceptions)
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+
+        return _error_code;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Print how long every stage was busy or idle, which tells which of the stages is the bottleneck
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::print_report() const
+    {
+        StageStatistics inflate_statistics;
+        for (auto const &statistics : _inflate_statistics)
+        {
+            inflate_statistics.busy_time += statistics.busy_time;
+            inflate_statistics.idle_time += statistics.idle_time;
+            inflate_statistics.item_count += statistics.item_count;
+        }
+
+        fprintf(stdout, "----- Load pipeline finished in %.3f ms with following stage statistics:\n", _total_time);
+        _print_stage_statistics("walk", _walk_statistics, 1);
+        _print_stage_statistics("inflate", inflate_statistics, _inflate_statistics.size());
+        _print_stage_statistics("index", _index_statistics, 1);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract the entries of queued layers and hand them to the index stage, runs on one or more worker threads
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::_inflate(size_t p_worker_index, Archive &p_archive)
+    {
+        StageStatistics &statistics = _inflate_statistics[p_worker_index];
+
+        auto idle_start = std::chrono::steady_clock::now();
+        Layer *layer;
+        while (_layer_queue.pop(layer))
+        {
+            statistics.idle_time += _get_elapsed_time(idle_start);
+
+            /* After an exception, the remaining layers are still taken from the queue as to never block the walk */
+            if (!_exceptions[p_worker_index])
+            {
+                try
+                {
+                    auto busy_start = std::chrono::steady_clock::now();
+                    ExtractedEntry entry;
+                    entry.layer = layer;
+                    entry.error_code = layer->extract_layer_entry(_document_name, p_archive, entry.data, entry.default_pixel);
+                    statistics.busy_time += _get_elapsed_time(busy_start);
+                    statistics.item_count++;
+
+                    idle_start = std::chrono::steady_clock::now();
+                    _entry_queue.push(std::move(entry));
+                }
+                catch (...)
+                {
+                    _exceptions[p_worker_index] = std::current_exception();
+                    idle_start = std::chrono::steady_clock::now();
+                }
+            }
+            else
+            {
+                idle_start = std::chrono::steady_clock::now();
+            }
+        }
+        statistics.idle_time += _get_elapsed_time(idle_start);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Import the tiles of every extracted entry into its layer, runs on a single worker thread
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::_index()
+    {
+        std::exception_ptr &exception = _exceptions.back();
+
+        auto idle_start = std::chrono::steady_clock::now();
+        ExtractedEntry entry;
+        while (_entry_queue.pop(entry))
+        {
+            _index_statistics.idle_time += _get_elapsed_time(idle_start);
+
+            auto busy_start = std::chrono::steady_clock::now();
+            if (entry.error_code != UNZ_OK)
+            {
+                _error_code = UNZ_ERRNO;
+            }
+            else if (!exception)
+            {
+                try
+                {
+                    entry.layer->import_layer_data(std::move(entry.data), entry.default_pixel);
+                    _index_statistics.item_count++;
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+            }
+            /* Whatever is left of the entry gets released right away, instead of once the next entry arrives */
+            entry = ExtractedEntry();
+            _index_statistics.busy_time += _get_elapsed_time(busy_start);
+
+            idle_start = std::chrono::steady_clock::now();
+        }
+        _index_statistics.idle_time += _get_elapsed_time(idle_start);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Close the queues one after another and wait until every stage has drained them
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::_join()
+    {
+        if (!_is_started || _is_finished)
+        {
+            return;
+        }
+        _is_finished = true;
+
+        _layer_queue.close();
+        for (auto &thread : _inflate_threads)
+        {
+            thread.join();
+        }
+
+        /* Only once all inflate workers are done, nothing can be added to the entry queue anymore */
+        _entry_queue.close();
+        _index_thread.join();
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Print the statistics of a single stage to the output console
+    // ---------------------------------------------------------------------------------------------------------------------
+    void LoadPipeline::_print_stage_statistics(const char *p_stage_name, const StageStatistics &p_statistics, size_t p_thread_count) const
+    {
+        const double total_time = p_statistics.busy_time + p_statistics.idle_time;
+        const double busy_percentage = total_time > 0.0 ? 100.0 * p_statistics.busy_time / total_time : 0.0;
+        fprintf(stdout, "   >> %s: %zu item(s) on %zu thread(s), busy %.3f ms, idle %.3f ms (%.1f%% busy)\n",
+                p_stage_name, p_statistics.item_count, p_thread_count, p_statistics.busy_time, p_statistics.idle_time, busy_percentage);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_LOAD_PIPELINE_H
+#define KRA_LOAD_PIPELINE_H
+
+#include "kra_utility.h"
+
+#include "kra_archive.h"
+#include "kra_bounded_queue.h"
+#include "kra_layer.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+
+namespace kra
+{
+    /* This class keeps track of how long a single stage of the LoadPipeline was working or waiting on the other stages */
+    class StageStatistics
+    {
+    public:
+        double busy_time = 0.0;
+        double idle_time = 0.0;
+        size_t item_count = 0;
+    };
+
+    /* This class extracts the tile data of paint layers while 'maindoc.xml' is still being walked */
+    /* The walk (= calling thread) queues every paint layer it finds, after which the inflate stage extracts the layer's entry */
+    /* Extracted entries are handed to the index stage, which imports the tiles into the layer that is already part of the tree */
+    /* Both queues are bounded, so at most a handful of extracted entries are held in memory at the same time */
+    class LoadPipeline
+    {
+    private:
+        class ExtractedEntry
+        {
+        public:
+            Layer *layer = nullptr;
+            EntryData data;
+            EntryData default_pixel;
+            int error_code = UNZ_OK;
+        };
+
+        Archive &_archive;
+        std::string _document_name;
+
+        BoundedQueue<Layer *> _layer_queue;
+        BoundedQueue<ExtractedEntry> _entry_queue;
+
+        /* minizip handles can't be shared between threads, so every additional inflate worker gets its own */
+        std::vector<std::unique_ptr<Archive>> _worker_archives;
+        std::vector<std::thread> _inflate_threads;
+        std::thread _index_thread;
+
+        std::chrono::steady_clock::time_point _start_time;
+        double _total_time = 0.0;
+        StageStatistics _walk_statistics;
+        std::vector<StageStatistics> _inflate_statistics;
+        StageStatistics _index_statistics;
+
+        std::atomic<int> _error_code;
+        std::vector<std::exception_ptr> _exceptions;
+
+        bool _is_started = false;
+        bool _is_finished = false;
+
+        void _inflate(size_t p_worker_index, Archive &p_archive);
+        void _index();
+        void _join();
+
+        void _print_stage_statistics(const char *p_stage_name, const StageStatistics &p_statistics, size_t p_thread_count) const;
+
+    public:
+        LoadPipeline(Archive &p_archive, size_t p_queue_capacity);
+        ~LoadPipeline();
+
+        void start(const std::string &p_document_name);
+        bool is_started() const;
+        void push(Layer *p_layer);
+        int finish();
+
+        void print_report() const;
+    };
+};
+
+#endif // KRA_LOAD_PIPELINE_H
\ No newline at end of file
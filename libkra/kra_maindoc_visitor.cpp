@@ -0,0 +1,114 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_maindoc_visitor.h"
+
+namespace kra
+{
+    MaindocVisitor::MaindocVisitor(StringArena &p_strings) : _strings(p_strings)
+    {
+    }
+
+    bool MaindocVisitor::has_image() const
+    {
+        return _has_image;
+    }
+
+    const std::vector<Layer *> &MaindocVisitor::get_layer_stack() const
+    {
+        return _layer_stack;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Handle the start of an element, returns whether the element's children should be visited as well
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool MaindocVisitor::VisitEnter(const tinyxml2::XMLElement &p_element, const tinyxml2::XMLAttribute * /* p_first_attribute */)
+    {
+        const char *element_name = p_element.Name();
+
+        if (std::strcmp(element_name, "DOC") == 0)
+        {
+            return true;
+        }
+        else if (std::strcmp(element_name, "IMAGE") == 0)
+        {
+            /* Only the first image is ever imported */
+            if (_has_image)
+            {
+                return false;
+            }
+            _has_image = true;
+
+            width = p_element.UnsignedAttribute("width", 0);
+            height = p_element.UnsignedAttribute("height", 0);
+            const char *name_attribute = p_element.Attribute("name");
+            name = (name_attribute != nullptr) ? name_attribute : "";
+            const char *color_space_attribute = p_element.Attribute("colorspacename");
+            color_space_name = (color_space_attribute != nullptr) ? color_space_attribute : "";
+            return true;
+        }
+        else if (std::strcmp(element_name, "layers") == 0)
+        {
+            /* Both the image and every group layer keep their layers in here */
+            return _has_image;
+        }
+        else if (std::strcmp(element_name, "layer") != 0)
+        {
+            return false;
+        }
+
+        /* If it is not a paintlayer nor a grouplayer then we don't support it! */
+        const char *node_type = p_element.Attribute("nodetype");
+        std::unique_ptr<Layer> layer = std::make_unique<Layer>();
+        if (node_type != nullptr && std::strcmp(node_type, "paintlayer") == 0)
+        {
+            layer->type = PAINT_LAYER;
+        }
+        else if (node_type != nullptr && std::strcmp(node_type, "grouplayer") == 0)
+        {
+            layer->type = GROUP_LAYER;
+        }
+        else
+        {
+            _layer_stack.push_back(nullptr);
+            return false;
+        }
+
+        layer->import_attributes(&p_element, _strings);
+
+        Layer *visited_layer = layer.get();
+        if (_layer_stack.empty())
+        {
+            layers.push_back(std::move(layer));
+        }
+        else
+        {
+            _layer_stack.back()->children.push_back(std::move(layer));
+        }
+        _layer_stack.push_back(visited_layer);
+
+        if (on_layer)
+        {
+            on_layer(*visited_layer);
+        }
+
+        /* Only group layers have child layers, the children of paint layers are masks */
+        return visited_layer->type == GROUP_LAYER;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Handle the end of an element, always returns true as to keep visiting the element's siblings
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool MaindocVisitor::VisitExit(const tinyxml2::XMLElement &p_element)
+    {
+        if (std::strcmp(p_element.Name(), "layer") == 0 && !_layer_stack.empty())
+        {
+            _layer_stack.pop_back();
+        }
+
+        return true;
+    }
+};
\ No newline at end of file
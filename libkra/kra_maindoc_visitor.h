@@ -0,0 +1,54 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_MAINDOC_VISITOR_H
+#define KRA_MAINDOC_VISITOR_H
+
+#include "kra_utility.h"
+
+#include "kra_layer.h"
+
+#include "../tinyxml2/tinyxml2.h"
+
+#include <functional>
+
+namespace kra
+{
+    /* This class walks 'maindoc.xml' exactly once and builds the complete layer tree while doing so */
+    /* Anything that doesn't describe a layer (e.g. masks, keyframes or animation data) is skipped as a whole */
+    class MaindocVisitor : public tinyxml2::XMLVisitor
+    {
+    private:
+        /* The layer that is being visited at every depth of the tree, nullptr for layers that aren't supported */
+        std::vector<Layer *> _layer_stack;
+        bool _has_image = false;
+
+        StringArena &_strings;
+
+    public:
+        MaindocVisitor(StringArena &p_strings);
+
+        /* Document attributes as found on the (first) IMAGE element */
+        std::string name;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::string color_space_name;
+
+        std::vector<std::unique_ptr<Layer>> layers;
+
+        /* Called as soon as a layer's own attributes are known, which is before any of its children are visited */
+        std::function<void(Layer &)> on_layer;
+
+        bool has_image() const;
+        /* The layer that is currently being visited is at the back, preceded by all of its ancestors */
+        const std::vector<Layer *> &get_layer_stack() const;
+
+        bool VisitEnter(const tinyxml2::XMLElement &p_element, const tinyxml2::XMLAttribute *p_first_attribute) override;
+        bool VisitExit(const tinyxml2::XMLElement &p_element) override;
+    };
+};
+
+#endif // KRA_MAINDOC_VISITOR_H
\ No newline at end of file
@@ -0,0 +1,519 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_png.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#if defined(KRA_USE_LIBPNG)
+#include "../libpng/png.h"
+#else
+#include "../zlib/zlib.h"
+#endif
+
+namespace kra
+{
+#if defined(KRA_USE_LIBPNG)
+    /* The PNG-file is read straight from memory, libpng only ever asks for the next couple of bytes */
+    struct PngSource
+    {
+        const uint8_t *data;
+        size_t size;
+        size_t offset;
+    };
+
+    static void _read_png_source(png_structp p_png, png_bytep p_buffer, png_size_t p_length)
+    {
+        PngSource *source = (PngSource *)png_get_io_ptr(p_png);
+        if (p_length > source->size - source->offset)
+        {
+            png_error(p_png, "PNG-file is truncated");
+        }
+        std::memcpy(p_buffer, source->data + source->offset, p_length);
+        source->offset += p_length;
+    }
+
+    static void _on_png_error(png_structp p_png, png_const_charp p_message)
+    {
+        fprintf(stderr, "ERROR: %s\n", p_message);
+        png_longjmp(p_png, 1);
+    }
+
+    static void _on_png_warning(png_structp /* p_png */, png_const_charp p_message)
+    {
+        if (verbosity_level > QUIET)
+        {
+            fprintf(stdout, "WARNING: %s\n", p_message);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Read the PNG-file's header & rows, every libpng error jumps straight back to decode_png()
+    // NOTE: Nothing in here may need a destructor, as it is skipped when libpng jumps out of this function!
+    // ---------------------------------------------------------------------------------------------------------------------
+    static int _read_png(png_structp p_png, png_infop p_info, unsigned int &p_width, unsigned int &p_height, std::vector<uint8_t> &p_result)
+    {
+        png_read_info(p_png, p_info);
+        const png_uint_32 width = png_get_image_width(p_png, p_info);
+        const png_uint_32 height = png_get_image_height(p_png, p_info);
+        if ((uint64_t)width * height * 4 > UINT_MAX)
+        {
+            fprintf(stderr, "ERROR: PNG dimensions %ux%u are not supported\n", width, height);
+            return 1;
+        }
+
+        /* Every color type & bit depth ends up as 8-bit RGBA, exactly like the built-in decoder does */
+        png_set_expand(p_png);
+        png_set_strip_16(p_png);
+        png_set_gray_to_rgb(p_png);
+        png_set_add_alpha(p_png, 0xFF, PNG_FILLER_AFTER);
+        const int pass_count = png_set_interlace_handling(p_png);
+        png_read_update_info(p_png, p_info);
+
+        p_result.resize((size_t)width * height * 4);
+        for (int pass = 0; pass < pass_count; pass++)
+        {
+            for (png_uint_32 y = 0; y < height; y++)
+            {
+                png_read_row(p_png, p_result.data() + (size_t)y * width * 4, NULL);
+            }
+        }
+        png_read_end(p_png, NULL);
+
+        p_width = width;
+        p_height = height;
+        return 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decode a complete PNG-file to 8-bit RGBA using libpng, which also verifies the CRC of every chunk
+    // ---------------------------------------------------------------------------------------------------------------------
+    int decode_png(const uint8_t *p_data, size_t p_size, unsigned int &p_width, unsigned int &p_height, std::vector<uint8_t> &p_result)
+    {
+        if (p_size < 8 || png_sig_cmp(p_data, 0, 8) != 0)
+        {
+            fprintf(stderr, "ERROR: Data does not start with a valid PNG signature\n");
+            return 1;
+        }
+
+        png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, _on_png_error, _on_png_warning);
+        png_infop info = (png != NULL) ? png_create_info_struct(png) : NULL;
+        if (info == NULL)
+        {
+            png_destroy_read_struct(&png, NULL, NULL);
+            return 1;
+        }
+
+        PngSource source = {p_data, p_size, 0};
+        png_set_read_fn(png, &source, _read_png_source);
+
+        int error_code = 1;
+        if (setjmp(png_jmpbuf(png)) == 0)
+        {
+            error_code = _read_png(png, info, p_width, p_height, p_result);
+        }
+
+        png_destroy_read_struct(&png, &info, NULL);
+        return error_code;
+    }
+#else
+    /* Color types as defined by the PNG specification */
+    enum PngColorType
+    {
+        PNG_GRAY = 0,
+        PNG_RGB = 2,
+        PNG_PALETTE = 3,
+        PNG_GRAY_ALPHA = 4,
+        PNG_RGB_ALPHA = 6
+    };
+
+    static uint32_t _read_uint32(const uint8_t *p_data)
+    {
+        return ((uint32_t)p_data[0] << 24) | ((uint32_t)p_data[1] << 16) | ((uint32_t)p_data[2] << 8) | (uint32_t)p_data[3];
+    }
+
+    static uint8_t _paeth_predictor(int p_left, int p_above, int p_upper_left)
+    {
+        const int estimate = p_left + p_above - p_upper_left;
+        const int distance_left = std::abs(estimate - p_left);
+        const int distance_above = std::abs(estimate - p_above);
+        const int distance_upper_left = std::abs(estimate - p_upper_left);
+
+        if (distance_left <= distance_above && distance_left <= distance_upper_left)
+        {
+            return (uint8_t)p_left;
+        }
+        return (uint8_t)((distance_above <= distance_upper_left) ? p_above : p_upper_left);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Undo the filter of a single scanline, the previous scanline should already be unfiltered (or all zeros)
+    // ---------------------------------------------------------------------------------------------------------------------
+    static bool _unfilter_scanline(uint8_t p_filter, uint8_t *p_row, const uint8_t *p_prior, size_t p_length, size_t p_bytes_per_pixel)
+    {
+        switch (p_filter)
+        {
+        case 0: /* None */
+            break;
+        case 1: /* Sub */
+            for (size_t i = p_bytes_per_pixel; i < p_length; i++)
+            {
+                p_row[i] += p_row[i - p_bytes_per_pixel];
+            }
+            break;
+        case 2: /* Up */
+            for (size_t i = 0; i < p_length; i++)
+            {
+                p_row[i] += p_prior[i];
+            }
+            break;
+        case 3: /* Average */
+            for (size_t i = 0; i < p_length; i++)
+            {
+                const int left = (i >= p_bytes_per_pixel) ? p_row[i - p_bytes_per_pixel] : 0;
+                p_row[i] += (uint8_t)((left + p_prior[i]) >> 1);
+            }
+            break;
+        case 4: /* Paeth */
+            for (size_t i = 0; i < p_length; i++)
+            {
+                const int left = (i >= p_bytes_per_pixel) ? p_row[i - p_bytes_per_pixel] : 0;
+                const int upper_left = (i >= p_bytes_per_pixel) ? p_prior[i - p_bytes_per_pixel] : 0;
+                p_row[i] += _paeth_predictor(left, p_prior[i], upper_left);
+            }
+            break;
+        default:
+            return false;
+        }
+
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the unscaled value of the sample at the given index of an unfiltered scanline
+    // ---------------------------------------------------------------------------------------------------------------------
+    static uint16_t _get_sample(const uint8_t *p_row, size_t p_index, unsigned int p_bit_depth)
+    {
+        switch (p_bit_depth)
+        {
+        case 16:
+            return (uint16_t)((p_row[2 * p_index] << 8) | p_row[2 * p_index + 1]);
+        case 8:
+            return p_row[p_index];
+        default:
+        {
+            /* Samples that are smaller than a byte are packed with the leftmost sample in the high-order bits */
+            const size_t bit_offset = p_index * p_bit_depth;
+            const unsigned int shift = 8 - p_bit_depth - (unsigned int)(bit_offset % 8);
+            return (uint16_t)((p_row[bit_offset / 8] >> shift) & ((1 << p_bit_depth) - 1));
+        }
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Scale an unscaled sample value to the full 8-bit range (16-bit samples simply lose their least significant byte)
+    // ---------------------------------------------------------------------------------------------------------------------
+    static uint8_t _scale_sample(uint16_t p_sample, unsigned int p_bit_depth)
+    {
+        switch (p_bit_depth)
+        {
+        case 16:
+            return (uint8_t)(p_sample >> 8);
+        case 8:
+            return (uint8_t)p_sample;
+        default:
+            return (uint8_t)(p_sample * 255 / ((1 << p_bit_depth) - 1));
+        }
+    }
+
+    /* Owns the z_stream, so that inflateEnd() is called on every way out of decode_png() once inflateInit() succeeded */
+    class PngInflater
+    {
+    public:
+        z_stream stream;
+        bool is_initialized = false;
+
+        PngInflater()
+        {
+            std::memset(&stream, 0, sizeof(stream));
+        }
+
+        ~PngInflater()
+        {
+            if (is_initialized)
+            {
+                inflateEnd(&stream);
+            }
+        }
+    };
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Decode a complete (non-interlaced) PNG-file to 8-bit RGBA using nothing but zlib
+    // ---------------------------------------------------------------------------------------------------------------------
+    int decode_png(const uint8_t *p_data, size_t p_size, unsigned int &p_width, unsigned int &p_height, std::vector<uint8_t> &p_result)
+    {
+        static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        if (p_size < 8 || std::memcmp(p_data, signature, 8) != 0)
+        {
+            fprintf(stderr, "ERROR: Data does not start with a valid PNG signature\n");
+            return 1;
+        }
+
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int bit_depth = 0;
+        unsigned int color_type = 0;
+        unsigned int channel_count = 0;
+
+        std::vector<uint8_t> palette;
+        std::vector<uint8_t> palette_alpha;
+        /* The single (unscaled) gray or RGB value that should be considered fully transparent, if any */
+        bool has_transparent_color = false;
+        uint16_t transparent_color[3] = {0, 0, 0};
+
+        /* Scanlines are inflated straight into this buffer, every one of them preceded by a filter type byte */
+        std::unique_ptr<uint8_t[]> scanlines;
+        size_t stride = 0;
+        size_t scanlines_size = 0;
+
+        PngInflater inflater;
+        z_stream &stream = inflater.stream;
+        int z_result = Z_OK;
+
+        size_t offset = 8;
+        bool has_ended = false;
+        while (!has_ended && offset + 12 <= p_size)
+        {
+            const uint32_t length = _read_uint32(p_data + offset);
+            const uint8_t *type = p_data + offset + 4;
+            const uint8_t *chunk = p_data + offset + 8;
+            if (length > p_size - offset - 12)
+            {
+                break;
+            }
+            offset += 12 + (size_t)length;
+
+            /* Just like libpng, a corrupt critical chunk is an error while a corrupt ancillary chunk is simply ignored */
+            if (crc32(0, type, length + 4) != _read_uint32(chunk + length))
+            {
+                if ((type[0] & 0x20) == 0)
+                {
+                    fprintf(stderr, "ERROR: PNG chunk '%.4s' has an invalid CRC\n", (const char *)type);
+                    return 1;
+                }
+                continue;
+            }
+
+            if (std::memcmp(type, "IHDR", 4) == 0)
+            {
+                if (length < 13)
+                {
+                    fprintf(stderr, "ERROR: PNG IHDR chunk is too short (%u bytes)\n", length);
+                    return 1;
+                }
+                /* The image data is inflated straight into the scanlines, so they can never be replaced by a second header */
+                if (scanlines != nullptr)
+                {
+                    fprintf(stderr, "ERROR: PNG-file contains more than one IHDR chunk\n");
+                    return 1;
+                }
+
+                width = _read_uint32(chunk);
+                height = _read_uint32(chunk + 4);
+                bit_depth = chunk[8];
+                color_type = chunk[9];
+                const unsigned int interlace_method = chunk[12];
+
+                switch (color_type)
+                {
+                case PNG_GRAY:
+                case PNG_PALETTE:
+                    channel_count = 1;
+                    break;
+                case PNG_GRAY_ALPHA:
+                    channel_count = 2;
+                    break;
+                case PNG_RGB:
+                    channel_count = 3;
+                    break;
+                case PNG_RGB_ALPHA:
+                    channel_count = 4;
+                    break;
+                default:
+                    fprintf(stderr, "ERROR: PNG color type %u is not valid\n", color_type);
+                    return 1;
+                }
+                if (bit_depth != 1 && bit_depth != 2 && bit_depth != 4 && bit_depth != 8 && bit_depth != 16)
+                {
+                    fprintf(stderr, "ERROR: PNG bit depth %u is not valid\n", bit_depth);
+                    return 1;
+                }
+                if (interlace_method != 0)
+                {
+                    fprintf(stderr, "ERROR: Interlaced PNG-files are not supported\n");
+                    return 1;
+                }
+
+                stride = ((size_t)width * channel_count * bit_depth + 7) / 8;
+                scanlines_size = (size_t)height * (stride + 1);
+                if (width == 0 || height == 0 || scanlines_size / height != stride + 1 || scanlines_size > UINT_MAX)
+                {
+                    fprintf(stderr, "ERROR: PNG dimensions %ux%u are not supported\n", width, height);
+                    return 1;
+                }
+                /* The buffer is left uninitialized, as every single byte of it gets overwritten anyway */
+                scanlines.reset(new uint8_t[scanlines_size]);
+            }
+            else if (std::memcmp(type, "PLTE", 4) == 0)
+            {
+                palette.assign(chunk, chunk + length);
+            }
+            else if (std::memcmp(type, "tRNS", 4) == 0)
+            {
+                if (color_type == PNG_PALETTE)
+                {
+                    palette_alpha.assign(chunk, chunk + length);
+                }
+                else if (color_type == PNG_GRAY && length >= 2)
+                {
+                    has_transparent_color = true;
+                    transparent_color[0] = (uint16_t)((chunk[0] << 8) | chunk[1]);
+                }
+                else if (color_type == PNG_RGB && length >= 6)
+                {
+                    has_transparent_color = true;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        transparent_color[i] = (uint16_t)((chunk[2 * i] << 8) | chunk[2 * i + 1]);
+                    }
+                }
+            }
+            else if (std::memcmp(type, "IDAT", 4) == 0)
+            {
+                if (scanlines == nullptr)
+                {
+                    fprintf(stderr, "ERROR: PNG IDAT chunk comes before the IHDR chunk\n");
+                    return 1;
+                }
+                if (!inflater.is_initialized)
+                {
+                    if (inflateInit(&stream) != Z_OK)
+                    {
+                        return 1;
+                    }
+                    inflater.is_initialized = true;
+                    stream.next_out = scanlines.get();
+                    stream.avail_out = (uInt)scanlines_size;
+                }
+
+                /* The image data can be split over any number of IDAT chunks, which together form a single zlib stream */
+                stream.next_in = (Bytef *)chunk;
+                stream.avail_in = length;
+                while (stream.avail_in > 0 && z_result == Z_OK)
+                {
+                    z_result = inflate(&stream, Z_NO_FLUSH);
+                }
+            }
+            else if (std::memcmp(type, "IEND", 4) == 0)
+            {
+                has_ended = true;
+            }
+        }
+
+        const bool is_complete = inflater.is_initialized && z_result == Z_STREAM_END && stream.avail_out == 0;
+        if (!is_complete)
+        {
+            fprintf(stderr, "ERROR: PNG image data is either missing or corrupt\n");
+            return 1;
+        }
+        if (color_type == PNG_PALETTE && palette.size() < 3)
+        {
+            fprintf(stderr, "ERROR: PNG palette is missing\n");
+            return 1;
+        }
+
+        /* Filters work on bytes, but never look further back than one (complete) pixel */
+        const size_t bytes_per_pixel = std::max((size_t)1, (size_t)(channel_count * bit_depth / 8));
+        std::vector<uint8_t> zero_row(stride, 0);
+
+        p_result.resize((size_t)width * height * 4);
+        for (unsigned int y = 0; y < height; y++)
+        {
+            uint8_t *row = scanlines.get() + (size_t)y * (stride + 1) + 1;
+            const uint8_t *prior = (y > 0) ? row - (stride + 1) : zero_row.data();
+            if (!_unfilter_scanline(row[-1], row, prior, stride, bytes_per_pixel))
+            {
+                fprintf(stderr, "ERROR: PNG filter type %u is not valid\n", row[-1]);
+                return 1;
+            }
+
+            uint8_t *destination = p_result.data() + (size_t)y * width * 4;
+            /* This is what Krita writes for 8-bit RGBA documents, so it doesn't have to go through the generic path */
+            if (color_type == PNG_RGB_ALPHA && bit_depth == 8)
+            {
+                std::memcpy(destination, row, stride);
+                continue;
+            }
+
+            for (unsigned int x = 0; x < width; x++)
+            {
+                uint8_t *pixel = destination + 4 * (size_t)x;
+                switch (color_type)
+                {
+                case PNG_GRAY:
+                {
+                    const uint16_t gray = _get_sample(row, x, bit_depth);
+                    pixel[0] = pixel[1] = pixel[2] = _scale_sample(gray, bit_depth);
+                    pixel[3] = (has_transparent_color && gray == transparent_color[0]) ? 0 : 255;
+                    break;
+                }
+                case PNG_GRAY_ALPHA:
+                    pixel[0] = pixel[1] = pixel[2] = _scale_sample(_get_sample(row, 2 * x, bit_depth), bit_depth);
+                    pixel[3] = _scale_sample(_get_sample(row, 2 * x + 1, bit_depth), bit_depth);
+                    break;
+                case PNG_RGB:
+                {
+                    bool is_transparent = has_transparent_color;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        const uint16_t sample = _get_sample(row, 3 * (size_t)x + c, bit_depth);
+                        is_transparent = is_transparent && (sample == transparent_color[c]);
+                        pixel[c] = _scale_sample(sample, bit_depth);
+                    }
+                    pixel[3] = is_transparent ? 0 : 255;
+                    break;
+                }
+                case PNG_PALETTE:
+                {
+                    /* Out-of-range indices are an error according to the specification, but are simply shown as black here */
+                    const uint16_t index = _get_sample(row, x, bit_depth);
+                    const bool is_valid = 3 * (size_t)index + 2 < palette.size();
+                    pixel[0] = is_valid ? palette[3 * index] : 0;
+                    pixel[1] = is_valid ? palette[3 * index + 1] : 0;
+                    pixel[2] = is_valid ? palette[3 * index + 2] : 0;
+                    pixel[3] = (index < palette_alpha.size()) ? palette_alpha[index] : 255;
+                    break;
+                }
+                case PNG_RGB_ALPHA:
+                    for (int c = 0; c < 4; c++)
+                    {
+                        pixel[c] = _scale_sample(_get_sample(row, 4 * (size_t)x + c, bit_depth), bit_depth);
+                    }
+                    break;
+                }
+            }
+        }
+
+        p_width = width;
+        p_height = height;
+        return 0;
+    }
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,20 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_PNG_H
+#define KRA_PNG_H
+
+#include "kra_utility.h"
+
+namespace kra
+{
+    /* Decode a complete PNG-file to 8-bit RGBA, such as the 'mergedimage.png' that Krita writes itself */
+    /* libpng is used when compiled with KRA_USE_LIBPNG, otherwise a built-in decoder that only needs zlib is used instead */
+    /* NOTE: The built-in decoder doesn't support interlaced PNG-files, which Krita never writes anyway! */
+    int decode_png(const uint8_t *p_data, size_t p_size, unsigned int &p_width, unsigned int &p_height, std::vector<uint8_t> &p_result);
+};
+
+#endif // KRA_PNG_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_string_arena.h"
+
+#include <algorithm>
+
+#define ARENA_BLOCK_SIZE (16384)
+
+namespace kra
+{
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get a view of the arena's own copy of the given string, which is only copied if it wasn't interned before
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::string_view StringArena::intern(std::string_view p_string)
+    {
+        /* The table is kept at most half full, so that probing always ends quickly on an empty slot */
+        if (2 * (_string_count + 1) > _slots.size())
+        {
+            _grow_slots();
+        }
+
+        const size_t mask = _slots.size() - 1;
+        size_t index = std::hash<std::string_view>()(p_string) & mask;
+        while (_slots[index].data() != nullptr)
+        {
+            if (_slots[index] == p_string)
+            {
+                return _slots[index];
+            }
+            index = (index + 1) & mask;
+        }
+
+        /* Interned strings are always null-terminated, so that they can be handed to C-functions as well */
+        char *data = _allocate(p_string.size() + 1);
+        std::memcpy(data, p_string.data(), p_string.size());
+        data[p_string.size()] = '\0';
+
+        std::string_view interned_string(data, p_string.size());
+        _slots[index] = interned_string;
+        _string_count++;
+        return interned_string;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Identical to the above, but a nullptr (e.g. a missing XML-attribute) is interned as an empty string
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::string_view StringArena::intern(const char *p_string)
+    {
+        return intern(std::string_view(p_string != nullptr ? p_string : ""));
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Release all strings at once, any view that was returned before is dangling afterwards
+    // ---------------------------------------------------------------------------------------------------------------------
+    void StringArena::clear()
+    {
+        _slots.clear();
+        _string_count = 0;
+        _blocks.clear();
+        _block_capacity = 0;
+        _block_size = 0;
+        _memory_usage = 0;
+    }
+
+    size_t StringArena::get_string_count() const
+    {
+        return _string_count;
+    }
+
+    size_t StringArena::get_memory_usage() const
+    {
+        return _memory_usage;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Double the size of the hash table and re-insert all strings, none of the strings themselves are moved
+    // ---------------------------------------------------------------------------------------------------------------------
+    void StringArena::_grow_slots()
+    {
+        std::vector<std::string_view> slots(std::max((size_t)64, 2 * _slots.size()));
+        const size_t mask = slots.size() - 1;
+        for (const std::string_view &string : _slots)
+        {
+            if (string.data() == nullptr)
+            {
+                continue;
+            }
+
+            size_t index = std::hash<std::string_view>()(string) & mask;
+            while (slots[index].data() != nullptr)
+            {
+                index = (index + 1) & mask;
+            }
+            slots[index] = string;
+        }
+        _slots = std::move(slots);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Reserve space in the current block, a new block is only started when the current one is full
+    // ---------------------------------------------------------------------------------------------------------------------
+    char *StringArena::_allocate(size_t p_size)
+    {
+        if (_blocks.empty() || _block_size + p_size > _block_capacity)
+        {
+            /* Exceptionally long strings simply get a block of their own */
+            _block_capacity = std::max((size_t)ARENA_BLOCK_SIZE, p_size);
+            _block_size = 0;
+            _blocks.emplace_back(new char[_block_capacity]);
+            _memory_usage += _block_capacity;
+        }
+
+        char *data = _blocks.back().get() + _block_size;
+        _block_size += p_size;
+        return data;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,45 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_STRING_ARENA_H
+#define KRA_STRING_ARENA_H
+
+#include "kra_utility.h"
+
+#include <string_view>
+
+namespace kra
+{
+    /* This class owns the strings of all layers of a document, every distinct string is only stored once */
+    /* Strings are packed together in large blocks, so interning thousands of them only takes a handful of allocations */
+    /* NOTE: The returned views stay valid until the arena is cleared or destroyed, moving the arena doesn't invalidate them! */
+    class StringArena
+    {
+    private:
+        std::vector<std::unique_ptr<char[]>> _blocks;
+        size_t _block_capacity = 0;
+        size_t _block_size = 0;
+        size_t _memory_usage = 0;
+
+        /* Open-addressing hash table of all interned strings, so that finding a string doesn't allocate anything either */
+        /* NOTE: Empty slots are recognized by their nullptr data, as even an interned empty string points into a block! */
+        std::vector<std::string_view> _slots;
+        size_t _string_count = 0;
+
+        char *_allocate(size_t p_size);
+        void _grow_slots();
+
+    public:
+        std::string_view intern(std::string_view p_string);
+        std::string_view intern(const char *p_string);
+        void clear();
+
+        size_t get_string_count() const;
+        size_t get_memory_usage() const;
+    };
+};
+
+#endif // KRA_STRING_ARENA_H
\ No newline at end of file
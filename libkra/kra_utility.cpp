@@ -6,46 +6,224 @@
 
 #include "kra_utility.h"
 
+#include <algorithm>
+#include <climits>
+#include <new>
+#include <thread>
+
 namespace kra
 {
     VerbosityLevel verbosity_level = NORMAL;
+#if defined(__linux__)
+    ArchiveBackend archive_backend = MMAP_BACKEND;
+#else
+    ArchiveBackend archive_backend = STDIO_BACKEND;
+#endif
+    unsigned int thread_count = 0;
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the actual number of worker threads that should be used for parallel work
+    // ---------------------------------------------------------------------------------------------------------------------
+    unsigned int get_thread_count()
+    {
+        if (thread_count > 0)
+        {
+            return thread_count;
+        }
+
+        /* hardware_concurrency() is allowed to return zero when it can't be determined */
+        const unsigned int hardware_thread_count = std::thread::hardware_concurrency();
+        return (hardware_thread_count > 0) ? hardware_thread_count : 1;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Check the sizes of an entry as found in the central directory, before any memory is allocated based on them
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool is_plausible_entry_size(unsigned long p_compression_method, uint64_t p_compressed_size, uint64_t p_uncompressed_size, uint64_t p_archive_size)
+    {
+        /* The compressed data has to be part of the archive, the size of which is unknown (= zero) for some archives */
+        if (p_archive_size > 0 && p_compressed_size > p_archive_size)
+        {
+            return false;
+        }
+        if (p_uncompressed_size > (uint64_t)SIZE_MAX)
+        {
+            return false;
+        }
+
+        /* STORED entries are never larger than their raw bytes, every other method can't beat the ratio of deflate */
+        if (p_compression_method == 0)
+        {
+            return p_uncompressed_size <= p_compressed_size;
+        }
+        return p_uncompressed_size / MAX_DEFLATE_RATIO <= p_compressed_size;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Keep reading the current (opened) file into the buffer until it is full or the file has no more data
+    // ---------------------------------------------------------------------------------------------------------------------
+    static int _read_current_file(unzFile &p_file, unsigned char *p_buffer, size_t &p_size)
+    {
+        size_t size = 0;
+        while (size < p_size)
+        {
+            /* unzReadCurrentFile() can't read more than INT_MAX bytes at once */
+            const unsigned int length = (unsigned int)std::min(p_size - size, (size_t)INT_MAX);
+            const int bytes_read = unzReadCurrentFile(p_file, p_buffer + size, length);
+            if (bytes_read < 0)
+            {
+                return bytes_read;
+            }
+            if (bytes_read == 0)
+            {
+                break;
+            }
+            size += (size_t)bytes_read;
+        }
+
+        p_size = size;
+        return UNZ_OK;
+    }
 
     // ---------------------------------------------------------------------------------------------------------------------
-    // Extract the data content of the current file in the ZIP archive to a vector
+    // Read the compressed bytes of the current file as-is and inflate all of them at once
     // ---------------------------------------------------------------------------------------------------------------------
-    int extract_current_file_to_vector(unzFile &p_file, std::vector<unsigned char> &p_result)
+    static int _inflate_current_file(unzFile &p_file, const unz_file_info64 &p_file_info, unsigned char *p_result)
+    {
+        /* Opening the file in raw mode skips minizip's own (chunked) inflate */
+        int error_code = unzOpenCurrentFile2(p_file, NULL, NULL, 1);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
+
+        size_t compressed_size = (size_t)p_file_info.compressed_size;
+        std::unique_ptr<unsigned char[]> compressed_data(new (std::nothrow) unsigned char[compressed_size]);
+        if (compressed_data == nullptr)
+        {
+            unzCloseCurrentFile(p_file);
+            fprintf(stderr, "ERROR: Failed to allocate %zu bytes for the compressed data of an archive entry\n", compressed_size);
+            return UNZ_INTERNALERROR;
+        }
+        error_code = _read_current_file(p_file, compressed_data.get(), compressed_size);
+        /* NOTE: minizip doesn't check the CRC-32 of raw reads, so there's no point in looking at the return value */
+        unzCloseCurrentFile(p_file);
+
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
+        if (compressed_size != p_file_info.compressed_size)
+        {
+            return UNZ_BADZIPFILE;
+        }
+
+        return inflate_entry_data(compressed_data.get(), compressed_size, p_result, p_file_info.uncompressed_size, p_file_info.crc);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Extract the data content of the current file in the ZIP archive to a buffer that is allocated to fit exactly
+    // ---------------------------------------------------------------------------------------------------------------------
+    int extract_current_file_to_buffer(unzFile &p_file, std::unique_ptr<unsigned char[]> &p_result, size_t &p_size)
     {
-        size_t error_code = UNZ_ERRNO;
         unz_file_info64 file_info = {0};
-        char filename_inzip[256] = {0};
+        int error_code = unzGetCurrentFileInfo64(p_file, &file_info, NULL, 0, NULL, 0, NULL, 0);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
 
-        /* Get the required size necessary to store the file content. */
-        error_code = unzGetCurrentFileInfo64(p_file, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-        size_t uncompressed_size = file_info.uncompressed_size;
+        /* The buffer is left uninitialized, as every single byte of it gets overwritten anyway */
+        p_size = (size_t)file_info.uncompressed_size;
+        p_result.reset(new (std::nothrow) unsigned char[p_size]);
+        if (p_result == nullptr)
+        {
+            fprintf(stderr, "ERROR: Failed to allocate %zu bytes for an archive entry\n", p_size);
+            p_size = 0;
+            return UNZ_INTERNALERROR;
+        }
+
+        /* Entries with a data descriptor only know their sizes and CRC-32 after the fact, so those are streamed instead */
+        const bool is_deflated = (file_info.compression_method == Z_DEFLATED);
+        const bool is_encrypted = (file_info.flag & 1) != 0;
+        const bool has_data_descriptor = (file_info.flag & 8) != 0;
+        if (is_deflated && !is_encrypted && !has_data_descriptor)
+        {
+            return _inflate_current_file(p_file, file_info, p_result.get());
+        }
 
         error_code = unzOpenCurrentFile(p_file);
+        if (error_code != UNZ_OK)
+        {
+            return error_code;
+        }
 
-        std::vector<unsigned char> buffer;
-        buffer.resize(WRITEBUFFERSIZE);
-        p_result.reserve((size_t)file_info.uncompressed_size);
+        error_code = _read_current_file(p_file, p_result.get(), p_size);
+        /* The stream has to end exactly where the buffer ends, so there shouldn't be a single byte left to read either */
+        unsigned char extra_byte;
+        if (error_code == UNZ_OK && (p_size != file_info.uncompressed_size || unzReadCurrentFile(p_file, &extra_byte, 1) != 0))
+        {
+            error_code = UNZ_BADZIPFILE;
+        }
+        /* Be sure to close the file to avoid leakage, this is also where minizip verifies the CRC-32 */
+        const int close_error_code = unzCloseCurrentFile(p_file);
+
+        return (error_code != UNZ_OK) ? error_code : close_error_code;
+    }
 
-        /* error_code also serves as the number of bytes that were read... */
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Inflate a complete raw deflate stream in one go and verify the CRC-32 of the result
+    // ---------------------------------------------------------------------------------------------------------------------
+    int inflate_entry_data(const unsigned char *p_data, uint64_t p_size, unsigned char *p_result, uint64_t p_result_size, unsigned long p_crc)
+    {
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        /* ZIP entries don't have a zlib header, hence the negative window size */
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        {
+            return UNZ_INTERNALERROR;
+        }
+
+        stream.next_in = (Bytef *)p_data;
+        stream.next_out = (Bytef *)p_result;
+
+        /* zlib only counts up to 32 bits, so (very) large entries are passed in multiple parts */
+        uint64_t remaining_in = p_size;
+        uint64_t remaining_out = p_result_size;
+        int z_result;
         do
         {
-            /* Read the data in parts of size WRITEBUFFERSIZE */
-            /* and keep reading until the function returns zero or lower. */
-            error_code = unzReadCurrentFile(p_file, buffer.data(), (unsigned int)buffer.size());
-            if (error_code < 0 || error_code == 0)
-                break;
+            if (stream.avail_in == 0)
+            {
+                stream.avail_in = (uInt)std::min(remaining_in, (uint64_t)UINT_MAX);
+                remaining_in -= stream.avail_in;
+            }
+            if (stream.avail_out == 0)
+            {
+                stream.avail_out = (uInt)std::min(remaining_out, (uint64_t)UINT_MAX);
+                remaining_out -= stream.avail_out;
+            }
 
-            p_result.insert(p_result.end(), buffer.data(), buffer.data() + error_code);
+            /* Z_FINISH lets zlib inflate straight into the output without keeping a sliding window */
+            const int flush = (remaining_in == 0 && remaining_out == 0) ? Z_FINISH : Z_NO_FLUSH;
+            z_result = inflate(&stream, flush);
+        } while (z_result == Z_OK);
 
-        } while (error_code > 0);
+        /* The stream should end exactly where the output ends, anything else means that the entry is corrupt */
+        const bool is_complete = (z_result == Z_STREAM_END && stream.avail_out == 0 && remaining_out == 0);
+        inflateEnd(&stream);
+        if (!is_complete)
+        {
+            return UNZ_BADZIPFILE;
+        }
 
-        /* Be sure to close the file to avoid leakage. */
-        error_code = unzCloseCurrentFile(p_file);
+        uLong crc = crc32(0L, Z_NULL, 0);
+        for (uint64_t offset = 0; offset < p_result_size; offset += UINT_MAX)
+        {
+            crc = crc32(crc, p_result + offset, (uInt)std::min(p_result_size - offset, (uint64_t)UINT_MAX));
+        }
 
-        return (int)error_code;
+        return (crc == p_crc) ? UNZ_OK : UNZ_CRCERROR;
     }
 
     // ---------------------------------------------------------------------------------------------------------------------
@@ -11,10 +11,13 @@
 
 #include <cstring> // std::memcpy
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 #define WRITEBUFFERSIZE (8192)
+/* Deflate can't compress data any better than about 1:1032, so an entry that claims a larger ratio can't be valid */
+#define MAX_DEFLATE_RATIO (1032)
 
 namespace kra
 {
@@ -42,9 +45,30 @@ namespace kra
         VERY_VERBOSE
     };
 
+    enum ArchiveBackend
+    {
+        STDIO_BACKEND,
+        MMAP_BACKEND
+    };
+
+    /* Index of a layer in the document's flat layer table, which stays valid for as long as the document isn't loaded again */
+    typedef uint32_t LayerHandle;
+    const LayerHandle INVALID_LAYER_HANDLE = UINT32_MAX;
+    /* Returned when no tile covers a position within a layer */
+    const uint32_t INVALID_TILE_INDEX = UINT32_MAX;
+
     extern VerbosityLevel verbosity_level;
+    extern ArchiveBackend archive_backend;
+    /* Maximum number of worker threads used for parallel work, zero means one thread per hardware thread */
+    extern unsigned int thread_count;
+
+    unsigned int get_thread_count();
+
+    bool is_plausible_entry_size(unsigned long p_compression_method, uint64_t p_compressed_size, uint64_t p_uncompressed_size, uint64_t p_archive_size);
+
+    int extract_current_file_to_buffer(unzFile &p_file, std::unique_ptr<unsigned char[]> &p_result, size_t &p_size);
 
-    int extract_current_file_to_vector(unzFile &p_file, std::vector<unsigned char> &p_result);
+    int inflate_entry_data(const unsigned char *p_data, uint64_t p_size, unsigned char *p_result, uint64_t p_result_size, unsigned long p_crc);
 
     ColorSpace get_color_space(const std::string &p_color_space_name);
 
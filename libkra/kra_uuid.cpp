@@ -0,0 +1,111 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#include "kra_uuid.h"
+
+#include <cstdio>
+
+namespace kra
+{
+    static int _get_hex_value(char p_character)
+    {
+        if (p_character >= '0' && p_character <= '9')
+        {
+            return p_character - '0';
+        }
+        if (p_character >= 'a' && p_character <= 'f')
+        {
+            return p_character - 'a' + 10;
+        }
+        if (p_character >= 'A' && p_character <= 'F')
+        {
+            return p_character - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Parse the textual representation of a UUID, returns false (and leaves the result untouched) if it is malformed
+    // ---------------------------------------------------------------------------------------------------------------------
+    bool Uuid::parse(std::string_view p_string, Uuid &p_result)
+    {
+        /* Only the braces are optional, the 32 hexadecimal digits are always split in groups of 8-4-4-4-12 digits */
+        const bool has_braces = !p_string.empty() && p_string.front() == '{';
+        if (p_string.size() != (has_braces ? 38 : 36))
+        {
+            return false;
+        }
+        if (has_braces && p_string.back() != '}')
+        {
+            return false;
+        }
+
+        const char *cursor = p_string.data() + (has_braces ? 1 : 0);
+        Uuid uuid;
+        for (int i = 0; i < 32; i++)
+        {
+            if ((i == 8 || i == 12 || i == 16 || i == 20) && *cursor++ != '-')
+            {
+                return false;
+            }
+
+            const int value = _get_hex_value(*cursor++);
+            if (value < 0)
+            {
+                return false;
+            }
+
+            uint64_t &half = (i < 16) ? uuid.high : uuid.low;
+            half = (half << 4) | (uint64_t)value;
+        }
+
+        p_result = uuid;
+        return true;
+    }
+
+    bool Uuid::parse(const char *p_string, Uuid &p_result)
+    {
+        return (p_string != nullptr) && parse(std::string_view(p_string), p_result);
+    }
+
+    bool Uuid::is_nil() const
+    {
+        return high == 0 && low == 0;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------
+    // Get the textual representation of this UUID, formatted identically to how Krita writes them
+    // ---------------------------------------------------------------------------------------------------------------------
+    std::string Uuid::to_string() const
+    {
+        char buffer[39];
+        std::snprintf(buffer, sizeof(buffer), "{%08x-%04x-%04x-%04x-%012llx}",
+                      (unsigned int)(high >> 32), (unsigned int)((high >> 16) & 0xFFFF), (unsigned int)(high & 0xFFFF),
+                      (unsigned int)(low >> 48), (unsigned long long)(low & 0xFFFFFFFFFFFFULL));
+        return std::string(buffer);
+    }
+
+    bool Uuid::operator==(const Uuid &p_other) const
+    {
+        return high == p_other.high && low == p_other.low;
+    }
+
+    bool Uuid::operator!=(const Uuid &p_other) const
+    {
+        return !(*this == p_other);
+    }
+
+    bool Uuid::operator<(const Uuid &p_other) const
+    {
+        return (high != p_other.high) ? (high < p_other.high) : (low < p_other.low);
+    }
+
+    size_t UuidHash::operator()(const Uuid &p_uuid) const
+    {
+        /* The bits of a UUID are (mostly) random already, so they only have to be folded together */
+        return (size_t)(p_uuid.high ^ (p_uuid.low * 0x9E3779B97F4A7C15ULL));
+    }
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+// ############################################################################ #
+// Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+// Licensed under the MIT License.
+// See LICENSE in the project root for license information.
+// ############################################################################ #
+
+#ifndef KRA_UUID_H
+#define KRA_UUID_H
+
+#include "kra_utility.h"
+
+#include <string_view>
+
+namespace kra
+{
+    /* This class stores a UUID as its 128-bit value, so that comparing or hashing it doesn't require any string operations */
+    /* Krita writes UUIDs as "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}", both with and without braces are accepted when parsing */
+    class Uuid
+    {
+    public:
+        uint64_t high = 0;
+        uint64_t low = 0;
+
+        static bool parse(const char *p_string, Uuid &p_result);
+        static bool parse(std::string_view p_string, Uuid &p_result);
+
+        bool is_nil() const;
+        std::string to_string() const;
+
+        bool operator==(const Uuid &p_other) const;
+        bool operator!=(const Uuid &p_other) const;
+        bool operator<(const Uuid &p_other) const;
+    };
+
+    /* Allows a Uuid to be used as the key of a std::unordered_map */
+    class UuidHash
+    {
+    public:
+        size_t operator()(const Uuid &p_uuid) const;
+    };
+};
+
+#endif // KRA_UUID_H
\ No newline at end of file
@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+# ############################################################################ #
+# Copyright © 2022-2026 Piet Bronders & Jeroen De Geeter <piet.bronders@gmail.com>
+# Licensed under the MIT License.
+# See LICENSE in the project root for license information.
+# ############################################################################ #
+
+# Generate a synthetic KRA-archive to benchmark libkra_cl with (see the 'Benchmarks' section of the README).
+# Every paint layer is a fully covered grid of 64x64 RGBA tiles, each of them randomly picked from a small pool of
+# (uniform, transparent, gradient & noise) tiles. The same arguments always generate the exact same archive.
+
+import argparse
+import random
+import zipfile
+
+TILE_SIZE = 64
+PIXEL_SIZE = 4
+
+
+# Compress the data the same way as Krita's LZF compression does (libs/image/tiles3/swap/kis_lzf_compression.cpp)
+def lzf_compress(data):
+    output = bytearray()
+    literal = bytearray()
+    table = {}
+
+    def flush_literal():
+        nonlocal literal
+        while literal:
+            chunk = literal[:32]
+            literal = literal[32:]
+            output.append(len(chunk) - 1)
+            output.extend(chunk)
+
+    i = 0
+    while i < len(data):
+        key = bytes(data[i:i + 3])
+        reference = table.get(key)
+        table[key] = i
+        if reference is not None and len(key) == 3 and i - reference - 1 < 8192 and i + 2 < len(data):
+            length = 3
+            max_length = min(264, len(data) - i)
+            while length < max_length and data[reference + length] == data[i + length]:
+                length += 1
+
+            flush_literal()
+            offset = i - reference - 1
+            if length - 2 < 7:
+                output.append(((length - 2) << 5) | (offset >> 8))
+            else:
+                output.append((7 << 5) | (offset >> 8))
+                output.append(length - 2 - 7)
+            output.append(offset & 255)
+
+            for k in range(i + 1, min(i + length, len(data) - 2)):
+                table[bytes(data[k:k + 3])] = k
+            i += length
+        else:
+            literal.append(data[i])
+            i += 1
+
+    flush_literal()
+    return bytes(output)
+
+
+# Get the (planar) pixel data of a single tile, as stored by Krita before compressing it
+def get_tile_data(kind, rnd):
+    area = TILE_SIZE * TILE_SIZE
+    if kind == 'uniform':
+        pixel = [rnd.randrange(256) for _ in range(PIXEL_SIZE)]
+        return b''.join(bytes([channel]) * area for channel in pixel)
+    if kind == 'transparent':
+        return bytes(area * PIXEL_SIZE)
+    if kind == 'gradient':
+        planes = []
+        for channel in range(PIXEL_SIZE):
+            base = rnd.randrange(256)
+            planes.append(bytes(((base + (i % TILE_SIZE) * (channel + 1) + (i // TILE_SIZE)) & 255) for i in range(area)))
+        return b''.join(planes)
+    return bytes(rnd.randrange(256) for _ in range(area * PIXEL_SIZE))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate a synthetic KRA-archive for benchmarking libkra_cl.')
+    parser.add_argument('output', help='path of the generated *.kra-file')
+    parser.add_argument('layers', type=int, help='number of paint layers')
+    parser.add_argument('grid', type=int, help='number of tiles in each direction of every layer')
+    parser.add_argument('--stored', action='store_true', help='store the entries instead of deflating them')
+    arguments = parser.parse_args()
+
+    rnd = random.Random(3)
+    kinds = ['uniform', 'transparent', 'gradient', 'noise', 'gradient', 'gradient']
+    pool = [b'\x01' + lzf_compress(get_tile_data(kinds[i % len(kinds)], rnd)) for i in range(24)]
+
+    compression = zipfile.ZIP_STORED if arguments.stored else zipfile.ZIP_DEFLATED
+    archive = zipfile.ZipFile(arguments.output, 'w')
+    archive.writestr(zipfile.ZipInfo('mimetype'), 'application/x-krita')
+
+    layers = []
+    for i in range(arguments.layers):
+        content = bytearray(('VERSION 2\nTILEWIDTH %d\nTILEHEIGHT %d\nPIXELSIZE %d\nDATA %d\n' % (TILE_SIZE, TILE_SIZE, PIXEL_SIZE, arguments.grid * arguments.grid)).encode())
+        for row in range(arguments.grid):
+            for column in range(arguments.grid):
+                tile = rnd.choice(pool)
+                content += ('%d,%d,LZF,%d\n' % (column * TILE_SIZE, row * TILE_SIZE, len(tile))).encode() + tile
+        archive.writestr(zipfile.ZipInfo('Big/layers/layer%d' % (i + 2)), bytes(content), compress_type=compression)
+        layers.append('<layer name="paint%d" colorspacename="RGBA" x="0" nodetype="paintlayer" y="0" visible="1" opacity="255" '
+                      'filename="layer%d" uuid="{00000000-0000-0000-0000-%012x}"/>' % (i + 2, i + 2, i))
+
+    size = arguments.grid * TILE_SIZE
+    maindoc = ('<?xml version="1.0" encoding="UTF-8"?>\n<DOC><IMAGE name="Big" colorspacename="RGBA" width="%d" height="%d"><layers>' % (size, size)
+               + ''.join(layers) + '</layers></IMAGE></DOC>\n')
+    archive.writestr(zipfile.ZipInfo('maindoc.xml'), maindoc, compress_type=compression)
+    archive.close()
+
+
+if __name__ == '__main__':
+    main()
\ No newline at end of file
@@ -11,7 +11,18 @@
 
 #include "../libpng/png.h"
 
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+
+// When enabled, the complete archive is read into memory first and loaded from there
+// NOTE: The buffer has to outlive the document, as lazily loaded documents keep reading from it!
+static bool load_from_memory = false;
+static std::vector<uint8_t> memory_buffer;
+static kra::LoadOptions load_options;
+// When enabled, only the pre-flattened 'mergedimage.png' is exported instead of the separate layers
+static bool export_merged_image = false;
 
 // ---------------------------------------------------------------------------------------------------------------------
 // Export and save as a *.png-file with the help of the libpng-library.
@@ -109,7 +120,7 @@ void save_layer_to_image(const std::unique_ptr<kra::ExportedLayer> &layer)
 {
 	unsigned int layer_width = (unsigned int)(layer->right - layer->left);
 	unsigned int layer_height = (unsigned int)(layer->bottom - layer->top);
-	const std::string file_name = layer->name + ".png";
+	const std::string file_name = std::string(layer->name) + ".png";
 
 	/* Export the layer's data to a texture */
 	write_data_to_png(file_name.c_str(), layer_width, layer_height, layer->data.data());
@@ -128,9 +139,9 @@ void process_layer(const std::unique_ptr<kra::Document> &document, const std::un
 		break;
 	}
 	case kra::GROUP_LAYER:
-		for (auto const &uuid : layer->child_uuids)
+		for (kra::LayerHandle handle : layer->child_handles)
 		{
-			std::unique_ptr<kra::ExportedLayer> child = document->get_exported_layer_with_uuid(uuid);
+			std::unique_ptr<kra::ExportedLayer> child = document->get_exported_layer(handle);
 
 			process_layer(document, child);
 		}
@@ -138,18 +149,85 @@ void process_layer(const std::unique_ptr<kra::Document> &document, const std::un
 	}
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Load the document at the given path, either directly or by reading the archive into memory first
+// ---------------------------------------------------------------------------------------------------------------------
+int load_document(const std::unique_ptr<kra::Document> &document, const std::wstring &p_file_name)
+{
+	if (!load_from_memory)
+	{
+		return document->load(p_file_name, load_options);
+	}
+
+	const std::string path = std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(p_file_name);
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+	{
+		std::fprintf(stderr, "ERROR: Failed to read KRA/KRZ archive at path '%s'\n", path.c_str());
+		return 1;
+	}
+	memory_buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+	return document->load_from_memory(memory_buffer.data(), memory_buffer.size(), load_options);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Print the name, UUID and entry sizes of this layer and (recursively) of all of its children
+// ---------------------------------------------------------------------------------------------------------------------
+void print_layer_metadata(const std::unique_ptr<kra::Layer> &layer, int p_depth)
+{
+	std::cout << std::string(2 * p_depth, ' ') << "- " << layer->name << " " << layer->uuid;
+	switch (layer->type)
+	{
+	case kra::PAINT_LAYER:
+		std::cout << " [" << kra::get_color_space_name(layer->color_space) << ", "
+				  << layer->compressed_size << " bytes, " << layer->uncompressed_size << " bytes uncompressed]" << std::endl;
+		break;
+	case kra::GROUP_LAYER:
+		std::cout << " [group]" << std::endl;
+		for (auto const &child : layer->children)
+		{
+			print_layer_metadata(child, p_depth + 1);
+		}
+		break;
+	}
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // Export the document as found at the given path
 // ---------------------------------------------------------------------------------------------------------------------
 int export_document(std::wstring p_file_name)
 {
 	std::unique_ptr<kra::Document> document = std::make_unique<kra::Document>();
-	const int result = document->load(p_file_name);
+	const int result = load_document(document, p_file_name);
 	if (result != 0)
 	{
 		return result;
 	}
 
+	if (export_merged_image)
+	{
+		std::unique_ptr<kra::ExportedLayer> merged_image = document->get_merged_image();
+		if (merged_image->data.empty())
+		{
+			return 1;
+		}
+		save_layer_to_image(merged_image);
+		return 0;
+	}
+
+	/* Without any tile data there's nothing to export, so just print what is known about the document instead */
+	if (load_options.load_mode == kra::METADATA_ONLY)
+	{
+		std::cout << document->name << " (" << document->width << "x" << document->height << ", "
+				  << kra::get_color_space_name(document->color_space) << ")" << std::endl;
+		for (auto const &layer : document->layers)
+		{
+			print_layer_metadata(layer, 1);
+		}
+		return 0;
+	}
+
 	switch (document->color_space)
 	{
 	case kra::ColorSpace::RGBA:
@@ -168,17 +246,137 @@ int export_document(std::wstring p_file_name)
 	}
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Repeatedly load and export the document found at the given path without saving anything and print the timings
+// ---------------------------------------------------------------------------------------------------------------------
+int benchmark_document(std::wstring p_file_name, int p_count)
+{
+	double load_time = 0.0;
+	double export_time = 0.0;
+
+	for (int i = 0; i < p_count; i++)
+	{
+		std::unique_ptr<kra::Document> document = std::make_unique<kra::Document>();
+
+		auto start = std::chrono::steady_clock::now();
+		const int result = load_document(document, p_file_name);
+		if (result != 0)
+		{
+			return result;
+		}
+		auto loaded = std::chrono::steady_clock::now();
+		if (export_merged_image)
+		{
+			std::unique_ptr<kra::ExportedLayer> merged_image = document->get_merged_image();
+		}
+		else
+		{
+			std::vector<std::unique_ptr<kra::ExportedLayer>> exported_layers = document->get_all_exported_layers();
+		}
+		auto exported = std::chrono::steady_clock::now();
+
+		load_time += std::chrono::duration<double, std::milli>(loaded - start).count();
+		export_time += std::chrono::duration<double, std::milli>(exported - loaded).count();
+	}
+
+	std::cout << "Benchmarked " << p_count << " iteration(s):\n"
+			  << "  load   = " << load_time / p_count << " ms (average)\n"
+			  << "  export = " << export_time / p_count << " ms (average)" << std::endl;
+	return 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Repeatedly time the separate stages of loading and exporting every paint layer of the document found at the given
+// path: extracting its entry from the archive, parsing its tiles and composing them (using the -j number of threads)
+// ---------------------------------------------------------------------------------------------------------------------
+int benchmark_document_stages(std::wstring p_file_name, int p_count)
+{
+	/* Only the layer tree is needed, the layer entries themselves are extracted by the benchmark */
+	const kra::LoadOptions options = load_options;
+	load_options.load_mode = kra::METADATA_ONLY;
+	std::unique_ptr<kra::Document> document = std::make_unique<kra::Document>();
+	const int result = load_document(document, p_file_name);
+	load_options = options;
+	if (result != 0)
+	{
+		return result;
+	}
+
+	std::shared_ptr<kra::Archive> archive = std::make_shared<kra::Archive>();
+	const int open_result = load_from_memory ? archive->open(std::make_shared<kra::MemoryReader>(memory_buffer.data(), memory_buffer.size()))
+											 : archive->open(std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(p_file_name));
+	if (open_result != 0)
+	{
+		std::fprintf(stderr, "ERROR: Failed to open KRA/KRZ archive for benchmarking\n");
+		return 1;
+	}
+
+	double extract_time = 0.0;
+	double parse_time = 0.0;
+	double compose_time = 0.0;
+	size_t tile_count = 0;
+	size_t composed_size = 0;
+
+	for (int i = 0; i < p_count; i++)
+	{
+		for (kra::LayerHandle handle = 0; handle < document->get_layer_count(); handle++)
+		{
+			const kra::Layer *layer = document->get_layer(handle);
+			if (layer->type != kra::PAINT_LAYER)
+			{
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			kra::EntryData layer_content;
+			kra::EntryData default_pixel;
+			if (layer->extract_layer_entry(document->name, *archive, layer_content, default_pixel) != UNZ_OK)
+			{
+				return 1;
+			}
+			auto extracted = std::chrono::steady_clock::now();
+			kra::LayerData layer_data;
+			layer_data.import_attributes(std::move(layer_content));
+			auto parsed = std::chrono::steady_clock::now();
+			std::vector<uint8_t> composed_data = layer_data.get_composed_data(layer->color_space, kra::thread_count);
+			auto composed = std::chrono::steady_clock::now();
+
+			extract_time += std::chrono::duration<double, std::milli>(extracted - start).count();
+			parse_time += std::chrono::duration<double, std::milli>(parsed - extracted).count();
+			compose_time += std::chrono::duration<double, std::milli>(composed - parsed).count();
+			tile_count += layer_data.get_tile_count();
+			composed_size += composed_data.size();
+		}
+	}
+
+	std::cout << "Benchmarked the stages of " << p_count << " iteration(s):\n"
+			  << "  extract = " << extract_time / p_count << " ms (average)\n"
+			  << "  parse   = " << parse_time / p_count << " ms (average, " << tile_count / p_count << " tiles)\n"
+			  << "  compose = " << compose_time / p_count << " ms (average, "
+			  << (compose_time > 0.0 ? composed_size / (compose_time * 1000.0) : 0.0) << " MB/s, " << kra::get_thread_count() << " thread(s))" << std::endl;
+	return 0;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 static void show_usage(std::string name)
 {
-	// TODO: Allow multiple sources!
 	// TODO: Add a destination option at some point!
-	std::cerr << "Usage: " << name << " [options]\n"
+	std::cerr << "Usage: " << name << " [options] [sources]\n"
 			  << "\n"
 			  << "General options:\n"
 			  << "  -h, --help                       Display this help message.\n"
-			  << "  -s, --source <source>            Specify the KRA source file.\n"
+			  << "  -s, --source <source>            Specify a KRA source file (repeatable, sources can also be given without -s).\n"
+			  << "  -b, --backend <backend>          Read the archive using 'mmap', 'stdio' or 'memory'.\n"
+			  << "  -n, --benchmark <count>          Load and export <count> times without saving and print the timings.\n"
+			  << "  -S, --stages                     Make --benchmark time the extract, parse and compose stages of every paint layer.\n"
+			  << "  -M, --merged                     Only export the pre-flattened 'mergedimage.png', no layer gets decoded.\n"
+			  << "  -m, --metadata                   Only print the document's metadata and layer tree, nothing gets exported.\n"
+			  << "  -f, --filter <layer>             Only load the layer with the given UUID, name or \"Group/Sub/Layer\" path (repeatable).\n"
+			  << "  -l, --lazy                       Only extract the tile data of a layer when it is exported.\n"
+			  << "  -p, --parallel                   Extract the layer entries concurrently.\n"
+			  << "  -P, --pipelined                  Extract the layer entries while the layer tree is still being read.\n"
+			  << "  -j, --threads <count>            Use at most <count> worker threads (default: one per hardware thread).\n"
 			  << "  -q, --quiet                      Do not print anything in the console.\n"
 			  << "  -v, --verbose                    Print additional logs in the console.\n";
 }
@@ -187,9 +385,11 @@ static void show_usage(std::string name)
 // ---------------------------------------------------------------------------------------------------------------------
 int main(int argc, const char *argv[])
 {
-	std::vector<std::string> sources;
+	std::vector<std::wstring> sources;
 	// NOTE: Maybe we shouldn't hardcode this? This is here mainly for debugging purposes.
-	std::wstring file_name = L"..\\examples\\example_RGBA.kra";
+	const std::wstring default_source = L"..\\examples\\example_RGBA.kra";
+	int benchmark_count = 0;
+	bool benchmark_stages = false;
 
 	for (int i = 1; i < argc; ++i)
 	{
@@ -204,8 +404,8 @@ int main(int argc, const char *argv[])
 			// Make sure we aren't at the end of argv!
 			if (i + 1 < argc)
 			{
-				std::string str = argv[i + 1]; // Increment 'i' so we don't get the argument as the next argv[i].
-				file_name = std::wstring(str.begin(), str.end());
+				std::string str = argv[++i]; // Increment 'i' so we don't get the argument as the next argv[i].
+				sources.push_back(std::wstring(str.begin(), str.end()));
 			}
 			else
 			{ // Uh-oh, there was no argument to the source option.
@@ -213,6 +413,112 @@ int main(int argc, const char *argv[])
 				return 1;
 			}
 		}
+		else if ((arg == "-b") || (arg == "--backend"))
+		{
+			if (i + 1 < argc)
+			{
+				std::string backend = argv[++i];
+				if (backend == "mmap")
+				{
+					kra::archive_backend = kra::MMAP_BACKEND;
+				}
+				else if (backend == "stdio")
+				{
+					kra::archive_backend = kra::STDIO_BACKEND;
+				}
+				else if (backend == "memory")
+				{
+					load_from_memory = true;
+				}
+				else
+				{
+					std::cerr << "--backend option should be either 'mmap', 'stdio' or 'memory'." << std::endl;
+					return 1;
+				}
+			}
+			else
+			{
+				std::cerr << "--backend option requires one argument." << std::endl;
+				return 1;
+			}
+		}
+		else if ((arg == "-n") || (arg == "--benchmark"))
+		{
+			if (i + 1 < argc)
+			{
+				benchmark_count = std::atoi(argv[++i]);
+			}
+			if (benchmark_count <= 0)
+			{
+				std::cerr << "--benchmark option requires a positive number of iterations." << std::endl;
+				return 1;
+			}
+		}
+		else if ((arg == "-S") || (arg == "--stages"))
+		{
+			benchmark_stages = true;
+		}
+		else if ((arg == "-M") || (arg == "--merged"))
+		{
+			export_merged_image = true;
+			load_options.load_merged_image = true;
+		}
+		else if ((arg == "-m") || (arg == "--metadata"))
+		{
+			load_options.load_mode = kra::METADATA_ONLY;
+		}
+		else if ((arg == "-f") || (arg == "--filter"))
+		{
+			if (i + 1 < argc)
+			{
+				/* Anything that parses as a UUID (with or without curly braces) is one, anything with a slash in it has to be a path */
+				std::string layer = argv[++i];
+				kra::Uuid uuid;
+				if (kra::Uuid::parse(layer, uuid))
+				{
+					load_options.layer_filter.uuids.push_back(layer);
+				}
+				else if (layer.find('/') != std::string::npos)
+				{
+					load_options.layer_filter.paths.push_back(layer);
+				}
+				else
+				{
+					load_options.layer_filter.names.push_back(layer);
+				}
+			}
+			else
+			{
+				std::cerr << "--filter option requires one argument." << std::endl;
+				return 1;
+			}
+		}
+		else if ((arg == "-l") || (arg == "--lazy"))
+		{
+			load_options.load_mode = kra::LAZY_LOAD;
+		}
+		else if ((arg == "-p") || (arg == "--parallel"))
+		{
+			load_options.extraction_mode = kra::PARALLEL_EXTRACTION;
+		}
+		else if ((arg == "-P") || (arg == "--pipelined"))
+		{
+			load_options.extraction_mode = kra::PIPELINED_EXTRACTION;
+		}
+		else if ((arg == "-j") || (arg == "--threads"))
+		{
+			int count = 0;
+			if (i + 1 < argc)
+			{
+				count = std::atoi(argv[++i]);
+			}
+			if (count <= 0)
+			{
+				std::cerr << "--threads option requires a positive number of threads." << std::endl;
+				return 1;
+			}
+			kra::thread_count = (unsigned int)count;
+		}
 		else if ((arg == "-q") || (arg == "--quiet"))
 		{
 			kra::verbosity_level = kra::QUIET;
@@ -223,14 +529,39 @@ int main(int argc, const char *argv[])
 		}
 		else
 		{
-			sources.push_back(argv[i]);
+			sources.push_back(std::wstring(arg.begin(), arg.end()));
 		}
 	}
 
-	const int result = export_document(file_name);
-	if (result != 0)
+	if (sources.empty())
 	{
-		return result;
+		sources.push_back(default_source);
+	}
+
+	/* All sources share the same XMLDocument, so that tinyXML2's memory pools are only allocated once */
+	load_options.xml_document = std::make_shared<tinyxml2::XMLDocument>();
+
+	/* The layers aren't needed at all for the merged image, unless they are loaded lazily anyway */
+	if (export_merged_image && load_options.load_mode == kra::FULL_LOAD)
+	{
+		load_options.load_mode = kra::METADATA_ONLY;
+	}
+
+	for (auto const &source : sources)
+	{
+		int result;
+		if (benchmark_count > 0)
+		{
+			result = benchmark_stages ? benchmark_document_stages(source, benchmark_count) : benchmark_document(source, benchmark_count);
+		}
+		else
+		{
+			result = export_document(source);
+		}
+		if (result != 0)
+		{
+			return result;
+		}
 	}
 
 	return 0;